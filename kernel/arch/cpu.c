@@ -0,0 +1,44 @@
+/* CPU Feature Setup
+ *
+ * Probes CPUID and turns on the FPU/SSE state the rest of the kernel may
+ * use. SSE needs both CR4.OSFXSR (the OS promises to save XMM state with
+ * FXSAVE) and CR0.EM clear; without SSE2 the string routines fall back to
+ * rep-string instructions.
+ */
+
+#include "cpu.h"
+
+bool cpu_sse2_enabled = false;
+
+uint32_t cpu_features(void)
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return edx;
+}
+
+/**
+ * Enable the FPU and, when the CPU has it, SSE/SSE2
+ */
+void cpu_init(void)
+{
+    uint32_t features = cpu_features();
+
+    if (!(features & CPUID_FEATURE_FPU))
+    {
+        vga_print("  CPU: no FPU\n");
+        return;
+    }
+
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    asm volatile("fninit");
+
+    if ((features & (CPUID_FEATURE_FXSR | CPUID_FEATURE_SSE | CPUID_FEATURE_SSE2)) ==
+        (CPUID_FEATURE_FXSR | CPUID_FEATURE_SSE | CPUID_FEATURE_SSE2))
+    {
+        write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        cpu_sse2_enabled = true;
+    }
+
+    vga_print(cpu_sse2_enabled ? "  CPU: FPU and SSE2 enabled\n" : "  CPU: FPU enabled, no SSE2\n");
+}
@@ -0,0 +1,56 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "../kernel.h"
+
+// CPUID leaf 1 EDX feature bits
+#define CPUID_FEATURE_FPU (1u << 0)
+#define CPUID_FEATURE_PSE (1u << 3)
+#define CPUID_FEATURE_PGE (1u << 13)
+#define CPUID_FEATURE_FXSR (1u << 24)
+#define CPUID_FEATURE_SSE (1u << 25)
+#define CPUID_FEATURE_SSE2 (1u << 26)
+
+// Control register bits
+#define CR0_MP 0x00000002 // WAIT/FWAIT honour CR0.TS
+#define CR0_EM 0x00000004 // Trap every FPU/SSE instruction
+#define CR0_TS 0x00000008 // Task switched: next FPU/SSE instruction raises #NM
+#define CR0_NE 0x00000020 // Native FPU error reporting
+#define CR0_WP 0x00010000 // Read-only pages fault on ring-0 writes too
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x00000010 // 4MB pages
+#define CR4_PGE 0x00000080 // Global pages
+#define CR4_OSFXSR 0x00000200     // FXSAVE/FXRSTOR and SSE instructions enabled
+#define CR4_OSXMMEXCPT 0x00000400 // Unmasked SSE exceptions raise #XM
+
+// Set once cpu_init() has turned SSE on; SSE2 code paths check this
+extern bool cpu_sse2_enabled;
+
+static inline uint32_t read_cr0(void)
+{
+    uint32_t value;
+    asm volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value)
+{
+    asm volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr4(void)
+{
+    uint32_t value;
+    asm volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value)
+{
+    asm volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+void cpu_init(void);
+uint32_t cpu_features(void);
+
+#endif
@@ -0,0 +1,242 @@
+/* Lazy FPU/SSE Context Switching
+ *
+ * FPU and SSE registers are not part of cpu_state_t. Instead, switching
+ * to any process other than the one whose state is in the registers sets
+ * CR0.TS, and that process's first FPU/SSE instruction raises #NM (vector
+ * 7). The trap writes the previous owner's registers back to its save
+ * area, loads the current process's and clears TS. Processes that never
+ * touch the FPU never get a save area and cost nothing on a switch.
+ *
+ * Save areas are 512-byte FXSAVE images from a slab cache, allocated on a
+ * process's first FPU use and starting out in the FNINIT state. The SSE2
+ * paths of libc/string.c count as FPU use of the calling process.
+ */
+
+#include "fpu.h"
+#include "cpu.h"
+#include "../proc/process.h"
+#include "../mem/slab.h"
+
+// Trap stub (interrupts.asm)
+extern void device_not_available_isr(void);
+
+struct process *fpu_owner = NULL;
+bool fpu_trap_armed = false;
+
+static slab_cache_t *fpu_cache = NULL;
+
+// Statistics
+static uint32_t fpu_traps = 0;
+static uint32_t fpu_first_uses = 0;
+static uint32_t fpu_saves = 0;
+static uint32_t fpu_restores = 0;
+
+/**
+ * Save area constructor - free areas in the cache hold the FNINIT state
+ */
+static void fpu_state_ctor(void *object)
+{
+    fpu_state_t *state = object;
+    memset(state, 0, sizeof(fpu_state_t));
+
+    if (cpu_sse2_enabled)
+    {
+        // FXSAVE layout: abridged tag word 0 marks every register empty
+        *(uint16_t *)&state->image[0] = FPU_DEFAULT_FCW;
+        *(uint32_t *)&state->image[24] = FPU_DEFAULT_MXCSR;
+    }
+    else
+    {
+        // FNSAVE layout: 32-bit control, status and tag words
+        *(uint32_t *)&state->image[0] = FPU_DEFAULT_FCW;
+        *(uint32_t *)&state->image[8] = 0xFFFF;
+    }
+}
+
+static inline void fpu_save(fpu_state_t *state)
+{
+    if (cpu_sse2_enabled)
+        asm volatile("fxsave %0" : "=m"(*state));
+    else
+        asm volatile("fnsave %0" : "=m"(*state)); // Also reinitialises the FPU
+    fpu_saves++;
+}
+
+static inline void fpu_restore(fpu_state_t *state)
+{
+    if (cpu_sse2_enabled)
+        asm volatile("fxrstor %0" : : "m"(*state));
+    else
+        asm volatile("frstor %0" : : "m"(*state));
+    fpu_restores++;
+}
+
+/**
+ * Write the owner's live registers back to its save area and leave the
+ * registers unowned, so the next FPU instruction traps
+ */
+static void fpu_spill(void)
+{
+    if (!fpu_owner)
+        return;
+
+    asm volatile("clts");
+    fpu_save(fpu_owner->fpu_state);
+    fpu_owner = NULL;
+    fpu_arm_trap();
+}
+
+/**
+ * Route #NM to the lazy switch and arm it. Without an FPU the vector is
+ * left on the halting default handler.
+ */
+void fpu_init(void)
+{
+    if (!(cpu_features() & CPUID_FEATURE_FPU))
+        return;
+
+    if (!fpu_cache)
+    {
+        fpu_cache = slab_cache_create("fpu_state", sizeof(fpu_state_t), CACHE_LINE_SIZE, fpu_state_ctor);
+    }
+
+    idt_set_gate(7, (uint32_t)device_not_available_isr, 0x08, 0x8E);
+
+    // Whatever the boot code left in the registers belongs to nobody
+    fpu_owner = NULL;
+    fpu_arm_trap();
+}
+
+/**
+ * Set CR0.TS: the next FPU/SSE instruction raises #NM
+ */
+void fpu_arm_trap(void)
+{
+    write_cr0(read_cr0() | CR0_TS);
+    fpu_trap_armed = true;
+}
+
+/**
+ * #NM handler: hand the FPU to the current process
+ */
+void fpu_device_not_available(void)
+{
+    process_t *process = current_process;
+
+    asm volatile("clts");
+    fpu_trap_armed = false;
+    fpu_traps++;
+
+    // Hardware task switches (the page-fault task) set TS behind our back
+    if (process == fpu_owner)
+        return;
+
+    if (fpu_owner)
+    {
+        fpu_save(fpu_owner->fpu_state);
+        fpu_owner = NULL;
+    }
+
+    // Boot code before the first process: nothing to keep
+    if (!process)
+        return;
+
+    if (!process->fpu_state)
+    {
+        process->fpu_state = fpu_cache ? slab_alloc(fpu_cache) : NULL;
+        if (!process->fpu_state)
+        {
+            vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+            vga_print("\nOut of memory for the FPU state of ");
+            vga_print(process->name);
+            vga_print(" - System Halted\n");
+            while (1)
+            {
+                asm volatile("cli; hlt");
+            }
+        }
+        fpu_first_uses++;
+    }
+
+    fpu_restore(process->fpu_state);
+    fpu_owner = process;
+}
+
+/**
+ * Give a forked child a copy of its parent's FPU state. Returns false if
+ * no save area could be allocated; a parent that never used the FPU
+ * needs none.
+ */
+bool fpu_copy(struct process *child, struct process *parent)
+{
+    if (!parent->fpu_state)
+        return true;
+
+    child->fpu_state = slab_alloc(fpu_cache);
+    if (!child->fpu_state)
+        return false;
+
+    if (parent == fpu_owner)
+    {
+        fpu_spill();
+    }
+
+    memcpy(child->fpu_state, parent->fpu_state, sizeof(fpu_state_t));
+    return true;
+}
+
+/**
+ * Drop a dying process's FPU state and return its save area
+ */
+void fpu_release(struct process *process)
+{
+    if (process == fpu_owner)
+    {
+        // Its registers must not leak to the next process that uses them
+        fpu_owner = NULL;
+        fpu_arm_trap();
+    }
+
+    if (process->fpu_state)
+    {
+        fpu_state_ctor(process->fpu_state);
+        slab_free(fpu_cache, process->fpu_state);
+        process->fpu_state = NULL;
+    }
+}
+
+void fpu_print_stats(void)
+{
+    if (!fpu_cache)
+    {
+        vga_print("No FPU\n");
+        return;
+    }
+
+    vga_print("Lazy FPU switching (");
+    vga_print(cpu_sse2_enabled ? "FXSAVE" : "FNSAVE");
+    vga_print(")\n  Owner: ");
+    if (fpu_owner)
+    {
+        vga_print(fpu_owner->name);
+        vga_print(" (PID ");
+        vga_print_dec(fpu_owner->pid);
+        vga_print(")\n");
+    }
+    else
+    {
+        vga_print("none\n");
+    }
+
+    vga_print("  Save areas: ");
+    vga_print_dec(fpu_cache->active_objects);
+    vga_print("\n  #NM traps: ");
+    vga_print_dec(fpu_traps);
+    vga_print(" (first uses ");
+    vga_print_dec(fpu_first_uses);
+    vga_print(", saves ");
+    vga_print_dec(fpu_saves);
+    vga_print(", restores ");
+    vga_print_dec(fpu_restores);
+    vga_print(")\n");
+}
@@ -0,0 +1,40 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include "../kernel.h"
+
+struct process;
+
+// FXSAVE image (FNSAVE uses the first 108 bytes on CPUs without FXSR)
+#define FPU_STATE_SIZE 512
+#define FPU_DEFAULT_FCW 0x037F   // x87 control word after FNINIT
+#define FPU_DEFAULT_MXCSR 0x1F80 // All SSE exceptions masked
+
+typedef struct fpu_state
+{
+    uint8_t image[FPU_STATE_SIZE];
+} __attribute__((aligned(16))) fpu_state_t;
+
+// Process whose FPU/SSE state is in the registers (NULL: nobody's)
+extern struct process *fpu_owner;
+extern bool fpu_trap_armed;
+
+void fpu_init(void);
+void fpu_arm_trap(void);
+void fpu_device_not_available(void);
+bool fpu_copy(struct process *child, struct process *parent);
+void fpu_release(struct process *process);
+void fpu_print_stats(void);
+
+/**
+ * Called before switching to `next`: unless it owns the live registers,
+ * its first FPU/SSE instruction must trap. Once CR0.TS is set it stays
+ * set, so switches between integer-only processes never touch CR0.
+ */
+static inline void fpu_switch(struct process *next)
+{
+    if (next != fpu_owner && !fpu_trap_armed)
+        fpu_arm_trap();
+}
+
+#endif
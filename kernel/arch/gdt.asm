@@ -0,0 +1,29 @@
+; gdt.asm - GDT and task register loading
+
+[BITS 32]
+
+[GLOBAL gdt_flush]
+[GLOBAL tss_flush]
+
+; Load the GDT and reload every segment register from it
+; void gdt_flush(uint32_t gdt_ptr)
+gdt_flush:
+    mov eax, [esp+4]
+    lgdt [eax]
+
+    mov ax, 0x10        ; Kernel data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    jmp 0x08:.reload_cs ; Kernel code segment
+.reload_cs:
+    ret
+
+; Load the task register
+; void tss_flush(uint16_t selector)
+tss_flush:
+    mov ax, [esp+4]
+    ltr ax
+    ret
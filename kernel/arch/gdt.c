@@ -0,0 +1,98 @@
+/* Global Descriptor Table - flat segments plus task state segments
+ *
+ * GRUB leaves us a GDT we do not own, so the kernel installs its own with
+ * the same flat code/data selectors and three TSS descriptors. The main TSS
+ * is the CPU's current task; fault handlers that must not trust the
+ * faulting stack (#PF, #DF) run as separate tasks reached through task
+ * gates, each with its own stack.
+ */
+
+#include "gdt.h"
+
+#define GDT_ENTRIES 6
+
+struct gdt_entry
+{
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_middle;
+    uint8_t access;
+    uint8_t granularity;
+    uint8_t base_high;
+} __attribute__((packed));
+
+struct gdt_ptr
+{
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+static struct gdt_entry gdt_entries[GDT_ENTRIES];
+static struct gdt_ptr gdt_p;
+
+tss_t main_tss;
+static tss_t page_fault_tss;
+static tss_t double_fault_tss;
+
+static void gdt_set_entry(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity)
+{
+    gdt_entries[num].base_low = base & 0xFFFF;
+    gdt_entries[num].base_middle = (base >> 16) & 0xFF;
+    gdt_entries[num].base_high = (base >> 24) & 0xFF;
+    gdt_entries[num].limit_low = limit & 0xFFFF;
+    gdt_entries[num].granularity = ((limit >> 16) & 0x0F) | (granularity & 0xF0);
+    gdt_entries[num].access = access;
+}
+
+static void gdt_set_tss(int num, tss_t *tss)
+{
+    memset(tss, 0, sizeof(tss_t));
+    tss->iomap_base = sizeof(tss_t); // No I/O permission bitmap
+
+    // Present, ring 0, available 32-bit TSS, byte granular
+    gdt_set_entry(num, (uint32_t)tss, sizeof(tss_t) - 1, 0x89, 0x00);
+}
+
+/**
+ * Prepare a fault task: it starts at `entry` on its own stack, with
+ * interrupts off, in the address space given by `cr3`
+ */
+void gdt_init_task(tss_t *tss, void (*entry)(void), void *stack_top, uint32_t cr3)
+{
+    tss->eip = (uint32_t)entry;
+    tss->esp = (uint32_t)stack_top;
+    tss->eflags = 0x2; // Reserved bit only, IF clear
+    tss->cr3 = cr3;
+    tss->cs = GDT_KERNEL_CODE;
+    tss->ds = GDT_KERNEL_DATA;
+    tss->es = GDT_KERNEL_DATA;
+    tss->fs = GDT_KERNEL_DATA;
+    tss->gs = GDT_KERNEL_DATA;
+    tss->ss = GDT_KERNEL_DATA;
+}
+
+void gdt_init(void)
+{
+    gdt_p.limit = (sizeof(struct gdt_entry) * GDT_ENTRIES) - 1;
+    gdt_p.base = (uint32_t)&gdt_entries;
+
+    gdt_set_entry(0, 0, 0, 0, 0);                // Null segment
+    gdt_set_entry(1, 0, 0xFFFFFFFF, 0x9A, 0xCF); // Kernel code
+    gdt_set_entry(2, 0, 0xFFFFFFFF, 0x92, 0xCF); // Kernel data
+    gdt_set_tss(3, &main_tss);
+    gdt_set_tss(4, &page_fault_tss);
+    gdt_set_tss(5, &double_fault_tss);
+
+    gdt_flush((uint32_t)&gdt_p);
+    tss_flush(GDT_MAIN_TSS);
+}
+
+tss_t *gdt_page_fault_tss(void)
+{
+    return &page_fault_tss;
+}
+
+tss_t *gdt_double_fault_tss(void)
+{
+    return &double_fault_tss;
+}
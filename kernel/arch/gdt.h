@@ -0,0 +1,39 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include "../kernel.h"
+
+// Segment selectors
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_MAIN_TSS 0x18         // Task state of whatever the CPU is running
+#define GDT_PAGE_FAULT_TSS 0x20   // Page-fault handler task
+#define GDT_DOUBLE_FAULT_TSS 0x28 // Double-fault handler task
+
+// 32-bit task state segment
+typedef struct
+{
+    uint32_t prev_task;
+    uint32_t esp0, ss0, esp1, ss1, esp2, ss2;
+    uint32_t cr3;
+    uint32_t eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+// Saved state of the task interrupted by a fault task
+extern tss_t main_tss;
+
+// Global Descriptor Table
+void gdt_init(void);
+void gdt_init_task(tss_t *tss, void (*entry)(void), void *stack_top, uint32_t cr3);
+tss_t *gdt_page_fault_tss(void);
+tss_t *gdt_double_fault_tss(void);
+
+extern void gdt_flush(uint32_t);
+extern void tss_flush(uint16_t);
+
+#endif
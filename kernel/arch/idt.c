@@ -1,6 +1,9 @@
 /* Interrupt Descriptor Table (IDT) - Fixed Version */
 
 #include "../kernel.h"
+#include "gdt.h"
+#include "../mem/vmm.h"
+#include "../proc/process.h"
 
 #define IDT_ENTRIES 256
 
@@ -35,6 +38,79 @@ extern void isr5(void);
 extern void isr6(void);
 extern void isr7(void);
 
+// IRQ stubs (interrupts.asm)
+extern void spurious_interrupt_wrapper(void);
+
+// Fault tasks (interrupts.asm)
+extern void page_fault_task(void);
+extern void double_fault_task(void);
+
+#define FAULT_STACK_SIZE 4096
+
+// 8259 PICs: IRQs 0-15 go to vectors 32-47, clear of the CPU exceptions
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA 0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA 0xA1
+#define PIC_IRQ_BASE 32
+#define PIC_CASCADE_IRQ 2
+
+static uint8_t page_fault_stack[FAULT_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t double_fault_stack[FAULT_STACK_SIZE] __attribute__((aligned(16)));
+
+/**
+ * Remap both PICs to PIC_IRQ_BASE with every line masked; drivers
+ * unmask their own IRQ once their handler is installed
+ */
+static void pic_remap(void)
+{
+    outb(PIC1_COMMAND, 0x11); // ICW1: edge triggered, cascaded, ICW4 follows
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, PIC_IRQ_BASE); // ICW2: vector offsets
+    outb(PIC2_DATA, PIC_IRQ_BASE + 8);
+    outb(PIC1_DATA, 1 << PIC_CASCADE_IRQ); // ICW3: slave on IRQ 2
+    outb(PIC2_DATA, PIC_CASCADE_IRQ);
+    outb(PIC1_DATA, 0x01); // ICW4: 8086 mode
+    outb(PIC2_DATA, 0x01);
+
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_unmask_irq(uint8_t irq)
+{
+    if (irq >= 8)
+    {
+        outb(PIC2_DATA, inb(PIC2_DATA) & ~(1 << (irq - 8)));
+        irq = PIC_CASCADE_IRQ;
+    }
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << irq));
+}
+
+/**
+ * True if the IRQ line is unmasked (a slave line also needs the cascade)
+ */
+bool pic_irq_unmasked(uint8_t irq)
+{
+    if (irq >= 8)
+    {
+        if (inb(PIC2_DATA) & (1 << (irq - 8)))
+            return false;
+        irq = PIC_CASCADE_IRQ;
+    }
+    return !(inb(PIC1_DATA) & (1 << irq));
+}
+
+/**
+ * True if the IRQ has been raised but not yet delivered (PIC IRR bit)
+ */
+bool pic_irq_pending(uint8_t irq)
+{
+    uint16_t port = irq >= 8 ? PIC2_COMMAND : PIC1_COMMAND;
+    outb(port, 0x0A); // OCW3: read the interrupt request register
+    return inb(port) & (1 << (irq & 7));
+}
+
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags)
 {
     idt_entries[num].base_low = base & 0xFFFF;
@@ -56,6 +132,50 @@ void exception_handler(void)
     }
 }
 
+/**
+ * Page fault handler - runs as its own task, so the faulting task's state
+ * is in main_tss. Faults in demand-paged process regions are filled in and
+ * the task resumes; anything else halts the machine. The task switch back
+ * sets CR0.TS, which the #NM handler clears on the next FPU instruction.
+ */
+void page_fault_handler(uint32_t error_code)
+{
+    uint32_t fault_addr;
+    asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
+
+    if (!process_handle_page_fault(vmm_current_directory(), fault_addr, error_code))
+    {
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+        vga_print("\nPAGE FAULT at ");
+        vga_print_hex(fault_addr);
+        vga_print(" (eip ");
+        vga_print_hex(main_tss.eip);
+        vga_print(", error ");
+        vga_print_hex(error_code);
+        vga_print(") - System Halted\n");
+        while (1)
+        {
+            asm volatile("cli; hlt");
+        }
+    }
+
+    // The task switch back loads CR3 from main_tss, which the CPU never saves
+    main_tss.cr3 = vmm_active_cr3;
+}
+
+/**
+ * Double fault handler - the faulting stack is likely gone, so just report
+ */
+void double_fault_handler(void)
+{
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    vga_print("\nDOUBLE FAULT (eip ");
+    vga_print_hex(main_tss.eip);
+    vga_print(", esp ");
+    vga_print_hex(main_tss.esp);
+    vga_print(") - System Halted\n");
+}
+
 void idt_init(void)
 {
     idt_p.limit = (sizeof(struct idt_entry) * IDT_ENTRIES) - 1;
@@ -79,7 +199,19 @@ void idt_init(void)
     idt_set_gate(4, (uint32_t)exception_handler, 0x08, 0x8E); // Overflow
     idt_set_gate(5, (uint32_t)exception_handler, 0x08, 0x8E); // Bound range
     idt_set_gate(6, (uint32_t)exception_handler, 0x08, 0x8E); // Invalid opcode
-    idt_set_gate(7, (uint32_t)exception_handler, 0x08, 0x8E); // Device not available
+    idt_set_gate(7, (uint32_t)exception_handler, 0x08, 0x8E); // Device not available (fpu_init)
+
+    // #DF and #PF run as separate tasks on their own stacks (task gates, 0x85)
+    uint32_t fault_cr3 = (uint32_t)vmm_kernel_directory();
+    gdt_init_task(gdt_double_fault_tss(), double_fault_task, double_fault_stack + FAULT_STACK_SIZE, fault_cr3);
+    gdt_init_task(gdt_page_fault_tss(), page_fault_task, page_fault_stack + FAULT_STACK_SIZE, fault_cr3);
+    idt_set_gate(8, 0, GDT_DOUBLE_FAULT_TSS, 0x85);  // Double fault
+    idt_set_gate(14, 0, GDT_PAGE_FAULT_TSS, 0x85);   // Page fault
+
+    // IRQs stay masked until their driver is ready; the master PIC can
+    // still raise a spurious IRQ 7, which must not find an empty gate
+    pic_remap();
+    idt_set_gate(PIC_IRQ_BASE + 7, (uint32_t)spurious_interrupt_wrapper, 0x08, 0x8E);
 
     // Load IDT
     idt_flush((uint32_t)&idt_p);
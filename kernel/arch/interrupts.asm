@@ -2,8 +2,13 @@
 
 [GLOBAL idt_flush]
 [GLOBAL timer_interrupt_wrapper]
+[GLOBAL keyboard_interrupt_wrapper]
+[GLOBAL spurious_interrupt_wrapper]
 [EXTERN exception_handler]
 [EXTERN timer_handler]
+[EXTERN page_fault_handler]
+[EXTERN double_fault_handler]
+[EXTERN fpu_device_not_available]
 
 ; Load IDT - Simple and safe
 idt_flush:
@@ -15,13 +20,44 @@ idt_flush:
 [GLOBAL exception_handler_asm]
 exception_handler_asm:
     pusha               ; Save all registers
+    cld                 ; C code needs the direction flag clear (memmove sets it)
     call exception_handler  ; Call C handler
     popa                ; Restore all registers
     iret                ; Return from interrupt
 
+; Device not available (#NM): first FPU/SSE instruction with CR0.TS set
+[GLOBAL device_not_available_isr]
+device_not_available_isr:
+    pusha
+    cld
+    call fpu_device_not_available
+    popa
+    iret
+
+; Page fault task, entered through a task gate so it has its own stack
+; even when the fault came from pushing onto an unmapped stack page.
+; The CPU pushes the error code on entry. IRET switches back to the
+; faulting task, and the next fault resumes this task at the jmp.
+[GLOBAL page_fault_task]
+page_fault_task:
+    call page_fault_handler ; Error code is the argument
+    add esp, 4              ; Drop the error code
+    iret
+    jmp page_fault_task
+
+; Double fault task - reports and halts
+[GLOBAL double_fault_task]
+double_fault_task:
+    call double_fault_handler
+.hang:
+    cli
+    hlt
+    jmp .hang
+
 ; Timer interrupt wrapper (IRQ 0)
 timer_interrupt_wrapper:
     pusha               ; Save all registers
+    cld                 ; IRET restores the interrupted direction flag
     push ds
     push es
     push fs
@@ -32,12 +68,13 @@ timer_interrupt_wrapper:
     mov ds, ax
     mov es, ax
     
-    ; Call C timer handler
-    call timer_handler
-    
-    ; Send EOI to PIC
+    ; EOI first: the handler may switch to another process, which then
+    ; returns through its own interrupt frame instead of this one
     mov al, 0x20
     out 0x20, al
+
+    ; Call C timer handler
+    call timer_handler
     
     ; Restore registers
     pop gs
@@ -47,3 +84,16 @@ timer_interrupt_wrapper:
     popa
     
     iret                ; Return from interrupt
+
+; Keyboard interrupt wrapper (IRQ 1) - only wakes the CPU from HLT;
+; the shell still reads the scancode from the controller itself
+keyboard_interrupt_wrapper:
+    push eax
+    mov al, 0x20
+    out 0x20, al        ; EOI to master PIC
+    pop eax
+    iret
+
+; Spurious IRQ 7 from the master PIC - no EOI for a spurious interrupt
+spurious_interrupt_wrapper:
+    iret
@@ -0,0 +1,702 @@
+/* Kernel Microbenchmarks
+ *
+ * Small rdtsc-timed loops exposed as shell commands, for comparing the
+ * cost of kernel mechanisms before and after a change.
+ */
+
+#include "bench.h"
+#include "mem/vmm.h"
+#include "arch/cpu.h"
+#include "proc/process.h"
+#include "proc/kthread.h"
+#include "proc/sched.h"
+#include "drivers/timer.h"
+
+// TLB benchmark: touch one word per page over a window far larger than the TLB
+#define TLB_BENCH_BLOCKS 4 // 4MB blocks backing the window
+#define TLB_BENCH_PAGES (TLB_BENCH_BLOCKS * (LARGE_PAGE_SIZE / PAGE_SIZE))
+#define TLB_BENCH_ROUNDS 8
+#define TLB_BENCH_STRIDE 1031 // Odd step: visits every page, defeats next-page prefetch
+
+#define TLB_BENCH_SMALL_BASE VMM_SCRATCH_BASE
+#define TLB_BENCH_LARGE_BASE (VMM_SCRATCH_BASE + TLB_BENCH_BLOCKS * LARGE_PAGE_SIZE)
+
+// Memory benchmark: move MEM_BENCH_BYTES per measurement at each size
+#define MEM_BENCH_ORDER 8         // 1MB buffers
+#define MEM_BENCH_BYTES 0x400000  // 4MB per measurement
+static const uint32_t mem_bench_sizes[] = {8, 64, 512, 4096, 65536, 0x100000};
+
+// String benchmark: scan STR_BENCH_BYTES of string per measurement
+#define STR_BENCH_BYTES 0x100000
+static const uint32_t str_bench_lengths[] = {8, 32, 128, 512, 2048};
+
+// Context switch benchmark: two contexts hand the CPU back and forth
+#define CTX_BENCH_ROUNDS 100000 // Two switches per round
+#define CTX_BENCH_STACK_SIZE 4096
+
+// Kernel thread benchmark: create this many at once, then tear them down
+#define KTHREAD_BENCH_COUNT 32
+#define KTHREAD_BENCH_JOINS 64
+
+// Deadline benchmark: a periodic task among CPU hogs, once as an
+// ordinary process and once with a deadline reservation
+#define EDF_BENCH_HOGS 3
+#define EDF_BENCH_JOBS 50
+#define EDF_BENCH_PERIOD 5  // Ticks between releases, also the deadline
+#define EDF_BENCH_RUNTIME 1 // Ticks reserved per period
+#define EDF_BENCH_WORK 20000 // Loop iterations per job
+
+static void bench_print_result(const char *label, uint64_t cycles, uint32_t operations)
+{
+    vga_print(label);
+    vga_print_dec((uint32_t)(cycles / operations));
+    vga_print(" cycles/access (");
+    vga_print_dec((uint32_t)(cycles / 1000));
+    vga_print("K total)\n");
+}
+
+/**
+ * Time TLB_BENCH_ROUNDS passes over the window starting at `base`, one
+ * access per page in a scattered order, starting from a cold TLB
+ */
+static uint64_t bench_tlb_pass(uint32_t base)
+{
+    volatile uint32_t *window = (volatile uint32_t *)base;
+    uint32_t sum = 0;
+
+    vmm_flush_tlb();
+    uint64_t start = rdtsc();
+
+    for (uint32_t round = 0; round < TLB_BENCH_ROUNDS; round++)
+    {
+        uint32_t page = round;
+        for (uint32_t i = 0; i < TLB_BENCH_PAGES; i++)
+        {
+            page = (page + TLB_BENCH_STRIDE) & (TLB_BENCH_PAGES - 1);
+            sum += window[page * (PAGE_SIZE / sizeof(uint32_t))];
+        }
+    }
+
+    uint64_t cycles = rdtsc() - start;
+    (void)sum;
+    return cycles;
+}
+
+/**
+ * Compare a TLB-miss-heavy loop over the same physical memory mapped with
+ * 4KB pages and with 4MB pages
+ */
+void bench_tlb(void)
+{
+    if (!vmm_is_enabled())
+    {
+        vga_print("Paging is off - nothing to measure\n");
+        return;
+    }
+
+    uint32_t *directory = vmm_kernel_directory();
+    uint32_t blocks[TLB_BENCH_BLOCKS];
+    uint32_t allocated = 0;
+
+    // Buddy blocks of the top order are 4MB aligned, as large pages need
+    while (allocated < TLB_BENCH_BLOCKS)
+    {
+        blocks[allocated] = pmm_alloc_pages(PMM_MAX_ORDER);
+        if (!blocks[allocated])
+            break;
+        allocated++;
+    }
+
+    if (allocated < TLB_BENCH_BLOCKS)
+    {
+        vga_print("Not enough free 4MB blocks for the benchmark\n");
+        while (allocated > 0)
+        {
+            pmm_free_pages(blocks[--allocated], PMM_MAX_ORDER);
+        }
+        return;
+    }
+
+    vmm_switch_directory(directory);
+
+    bool mapped = true;
+    for (uint32_t page = 0; page < TLB_BENCH_PAGES && mapped; page++)
+    {
+        uint32_t phys = blocks[page / (LARGE_PAGE_SIZE / PAGE_SIZE)] + (page % (LARGE_PAGE_SIZE / PAGE_SIZE)) * PAGE_SIZE;
+        mapped = vmm_map_page(directory, TLB_BENCH_SMALL_BASE + page * PAGE_SIZE, phys, PAGE_WRITABLE);
+    }
+    for (uint32_t block = 0; block < TLB_BENCH_BLOCKS && mapped; block++)
+    {
+        mapped = vmm_map_large_page(directory, TLB_BENCH_LARGE_BASE + block * LARGE_PAGE_SIZE, blocks[block], PAGE_WRITABLE);
+    }
+
+    if (mapped)
+    {
+        uint32_t accesses = TLB_BENCH_PAGES * TLB_BENCH_ROUNDS;
+
+        vga_print("TLB benchmark: ");
+        vga_print_dec(accesses);
+        vga_print(" scattered accesses over ");
+        vga_print_dec(TLB_BENCH_BLOCKS * 4);
+        vga_print("MB\n");
+
+        // Warm the data cache once so both runs see the same cache state
+        bench_tlb_pass(TLB_BENCH_LARGE_BASE);
+
+        bench_print_result("  4KB pages: ", bench_tlb_pass(TLB_BENCH_SMALL_BASE), accesses);
+        bench_print_result("  4MB pages: ", bench_tlb_pass(TLB_BENCH_LARGE_BASE), accesses);
+    }
+    else
+    {
+        vga_print("Could not map the benchmark window\n");
+    }
+
+    // The scratch page tables stay allocated and are reused by the next run
+    for (uint32_t page = 0; page < TLB_BENCH_PAGES; page++)
+    {
+        vmm_unmap_page(directory, TLB_BENCH_SMALL_BASE + page * PAGE_SIZE);
+    }
+    for (uint32_t block = 0; block < TLB_BENCH_BLOCKS; block++)
+    {
+        vmm_unmap_page(directory, TLB_BENCH_LARGE_BASE + block * LARGE_PAGE_SIZE);
+        pmm_free_pages(blocks[block], PMM_MAX_ORDER);
+    }
+}
+
+// The byte-at-a-time loops libc/string.c used before; kept from being
+// turned into calls to the very routines they are compared with
+__attribute__((optimize("no-tree-loop-distribute-patterns"))) static void bench_byte_copy(uint8_t *dest, const uint8_t *src, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        dest[i] = src[i];
+    }
+}
+
+__attribute__((optimize("no-tree-loop-distribute-patterns"))) static void bench_byte_fill(uint8_t *dest, uint8_t value, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        dest[i] = value;
+    }
+}
+
+/**
+ * Time MEM_BENCH_BYTES worth of copies (or fills, if src is NULL) of `size`
+ * bytes. Returns bytes per 1000 cycles.
+ */
+static uint32_t bench_mem_rate(uint8_t *dest, const uint8_t *src, uint32_t size, bool optimized)
+{
+    uint32_t rounds = MEM_BENCH_BYTES / size;
+    uint64_t start = rdtsc();
+
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        if (src && optimized)
+            memcpy(dest, src, size);
+        else if (src)
+            bench_byte_copy(dest, src, size);
+        else if (optimized)
+            memset(dest, round, size);
+        else
+            bench_byte_fill(dest, round, size);
+    }
+
+    uint64_t cycles = rdtsc() - start;
+    return cycles ? (uint32_t)((uint64_t)MEM_BENCH_BYTES * 1000 / cycles) : 0;
+}
+
+static void bench_print_column(uint32_t value, uint32_t width)
+{
+    uint32_t digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10)
+    {
+        digits++;
+    }
+
+    vga_print_dec(value);
+    while (digits++ < width)
+    {
+        vga_putchar(' ');
+    }
+}
+
+/**
+ * Compare memcpy/memset against the old byte loops from 8 bytes to 1MB
+ */
+void bench_mem(void)
+{
+    uint32_t dest = pmm_alloc_pages(MEM_BENCH_ORDER);
+    uint32_t src = pmm_alloc_pages(MEM_BENCH_ORDER);
+
+    if (!dest || !src)
+    {
+        vga_print("Not enough free memory for the benchmark\n");
+        if (dest)
+            pmm_free_pages(dest, MEM_BENCH_ORDER);
+        if (src)
+            pmm_free_pages(src, MEM_BENCH_ORDER);
+        return;
+    }
+
+    vga_print("Bytes per 1000 cycles, byte loop vs libc (SSE2 streaming ");
+    vga_print(cpu_sse2_enabled ? "on)\n" : "off)\n");
+    vga_print("SIZE     COPY LOOP  MEMCPY     FILL LOOP  MEMSET\n");
+
+    for (uint32_t i = 0; i < sizeof(mem_bench_sizes) / sizeof(mem_bench_sizes[0]); i++)
+    {
+        uint32_t size = mem_bench_sizes[i];
+
+        bench_print_column(size, 9);
+        bench_print_column(bench_mem_rate((uint8_t *)dest, (uint8_t *)src, size, false), 11);
+        bench_print_column(bench_mem_rate((uint8_t *)dest, (uint8_t *)src, size, true), 11);
+        bench_print_column(bench_mem_rate((uint8_t *)dest, NULL, size, false), 11);
+        bench_print_column(bench_mem_rate((uint8_t *)dest, NULL, size, true), 0);
+        vga_print("\n");
+    }
+
+    pmm_free_pages(dest, MEM_BENCH_ORDER);
+    pmm_free_pages(src, MEM_BENCH_ORDER);
+}
+
+// The byte loops libc/string.c and the shell helpers used before
+static size_t bench_byte_strlen(const char *str)
+{
+    size_t len = 0;
+    while (str[len])
+    {
+        len++;
+    }
+    return len;
+}
+
+static int bench_byte_strcmp(const char *str1, const char *str2)
+{
+    while (*str1 && (*str1 == *str2))
+    {
+        str1++;
+        str2++;
+    }
+    return *(unsigned char *)str1 - *(unsigned char *)str2;
+}
+
+/**
+ * Time STR_BENCH_BYTES worth of strlen (str2 NULL) or strcmp of two equal
+ * `length`-byte strings. Returns bytes per 1000 cycles.
+ */
+static uint32_t bench_str_rate(const char *str1, const char *str2, uint32_t length, bool optimized)
+{
+    uint32_t rounds = STR_BENCH_BYTES / length;
+    volatile uint32_t sink = 0;
+    uint64_t start = rdtsc();
+
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        if (str2 && optimized)
+            sink += strcmp(str1, str2);
+        else if (str2)
+            sink += bench_byte_strcmp(str1, str2);
+        else if (optimized)
+            sink += strlen(str1);
+        else
+            sink += bench_byte_strlen(str1);
+    }
+
+    uint64_t cycles = rdtsc() - start;
+    return cycles ? (uint32_t)((uint64_t)STR_BENCH_BYTES * 1000 / cycles) : 0;
+}
+
+/**
+ * Compare strlen/strcmp against the old byte loops for several lengths
+ */
+void bench_str(void)
+{
+    uint32_t buffer = pmm_alloc_frame();
+    if (!buffer)
+    {
+        vga_print("Not enough free memory for the benchmark\n");
+        return;
+    }
+
+    // Two strings in one page; the second starts off 16-byte alignment
+    char *str1 = (char *)buffer;
+    char *str2 = (char *)buffer + 2048 + 8;
+    uint32_t longest = str_bench_lengths[sizeof(str_bench_lengths) / sizeof(str_bench_lengths[0]) - 1];
+
+    vga_print("Bytes per 1000 cycles, byte loop vs libc (SSE2 ");
+    vga_print(cpu_sse2_enabled ? "on)\n" : "off)\n");
+    vga_print("LENGTH   STRLEN LOOP STRLEN     STRCMP LOOP STRCMP\n");
+
+    for (uint32_t i = 0; i < sizeof(str_bench_lengths) / sizeof(str_bench_lengths[0]); i++)
+    {
+        uint32_t length = str_bench_lengths[i];
+        if (length >= longest)
+            length = longest - 16; // Both strings and terminators fit the page
+
+        for (uint32_t j = 0; j < length; j++)
+        {
+            str1[j] = str2[j] = 'a' + j % 26;
+        }
+        str1[length] = str2[length] = '\0';
+
+        bench_print_column(length, 9);
+        bench_print_column(bench_str_rate(str1, NULL, length, false), 12);
+        bench_print_column(bench_str_rate(str1, NULL, length, true), 11);
+        bench_print_column(bench_str_rate(str1, str2, length, false), 12);
+        bench_print_column(bench_str_rate(str1, str2, length, true), 0);
+        vga_print("\n");
+    }
+
+    pmm_free_frame(buffer);
+}
+
+// Ping-pong contexts: bare PCBs with static stacks, outside the scheduler
+static process_t ctx_bench_shell, ctx_bench_ping, ctx_bench_pong;
+static uint8_t ctx_bench_stacks[2][CTX_BENCH_STACK_SIZE] __attribute__((aligned(16)));
+static uint64_t ctx_bench_cycles;
+
+static void ctx_bench_ping_task(void)
+{
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < CTX_BENCH_ROUNDS; i++)
+    {
+        context_switch(&ctx_bench_ping, &ctx_bench_pong);
+    }
+    ctx_bench_cycles = rdtsc() - start;
+
+    context_switch(&ctx_bench_ping, &ctx_bench_shell);
+}
+
+static void ctx_bench_pong_task(void)
+{
+    while (1)
+    {
+        context_switch(&ctx_bench_pong, &ctx_bench_ping);
+    }
+}
+
+static void ctx_bench_prepare(process_t *context, void (*entry)(void), uint8_t *stack)
+{
+    memset(context, 0, sizeof(*context));
+    context->cpu_state.eip = (uint32_t)entry;
+    context->cpu_state.esp = (uint32_t)stack + CTX_BENCH_STACK_SIZE - 4;
+    context->cpu_state.eflags = 0x002; // Interrupts stay off
+    context->cpu_state.cs = 0x08;
+}
+
+/**
+ * Time context_switch() between two contexts that only switch back and
+ * forth, so the cycles are the switch itself: callee-saved registers,
+ * the stack pointer swap and the address-space check
+ */
+void bench_context_switch(void)
+{
+    ctx_bench_prepare(&ctx_bench_ping, ctx_bench_ping_task, ctx_bench_stacks[0]);
+    ctx_bench_prepare(&ctx_bench_pong, ctx_bench_pong_task, ctx_bench_stacks[1]);
+    memset(&ctx_bench_shell, 0, sizeof(ctx_bench_shell));
+
+    uint32_t flags = irq_save();
+    context_switch(&ctx_bench_shell, &ctx_bench_ping);
+    irq_restore(flags);
+
+    uint32_t switches = CTX_BENCH_ROUNDS * 2;
+    vga_print("Context switch: ");
+    vga_print_dec((uint32_t)(ctx_bench_cycles / switches));
+    vga_print(" cycles/switch (");
+    vga_print_dec(switches);
+    vga_print(" switches, ");
+    vga_print_dec((uint32_t)(ctx_bench_cycles / 1000));
+    vga_print("K cycles)\n");
+}
+
+static void kthread_bench_task(void *arg)
+{
+    (void)arg;
+}
+
+/**
+ * Create KTHREAD_BENCH_COUNT kernel threads or processes and destroy them
+ * again without running them. Returns cycles per creation, or 0 if the
+ * system ran out of PIDs or memory.
+ */
+static uint32_t bench_create_rate(bool kthread)
+{
+    process_t *created[KTHREAD_BENCH_COUNT];
+    uint32_t count = 0;
+
+    uint64_t start = rdtsc();
+    for (; count < KTHREAD_BENCH_COUNT; count++)
+    {
+        created[count] = kthread ? kthread_create("bench", kthread_bench_task, NULL)
+                                 : process_create("bench", (void *)kthread_bench_task, PRIORITY_NORMAL);
+        if (!created[count])
+            break;
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        process_destroy(created[i]);
+    }
+
+    return count == KTHREAD_BENCH_COUNT ? (uint32_t)(cycles / count) : 0;
+}
+
+/**
+ * Compare creating a kernel thread with creating a process, and time a
+ * kernel thread's whole life: create, run, exit and join
+ */
+void bench_kthread(void)
+{
+    if (!current_process)
+    {
+        vga_print("No current process to own the threads\n");
+        return;
+    }
+
+    // Warm the PCB cache and the stack pools first
+    bench_create_rate(true);
+    bench_create_rate(false);
+
+    uint32_t thread_cycles = bench_create_rate(true);
+    uint32_t process_cycles = bench_create_rate(false);
+    if (!thread_cycles || !process_cycles)
+    {
+        vga_print("Out of PIDs or memory\n");
+        return;
+    }
+
+    vga_print("kthread_create: ");
+    vga_print_dec(thread_cycles);
+    vga_print(" cycles\nprocess_create: ");
+    vga_print_dec(process_cycles);
+    vga_print(" cycles (");
+    vga_print_dec(process_cycles / thread_cycles);
+    vga_print("x)\n");
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < KTHREAD_BENCH_JOINS; i++)
+    {
+        process_t *thread = kthread_create("bench", kthread_bench_task, NULL);
+        if (!thread)
+        {
+            vga_print("Out of PIDs or memory\n");
+            return;
+        }
+        kthread_join(thread);
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    vga_print("Create, run, exit and join: ");
+    vga_print_dec((uint32_t)(cycles / KTHREAD_BENCH_JOINS));
+    vga_print(" cycles\n");
+}
+
+typedef struct
+{
+    bool deadline;                       // Run with a reservation
+    bool rejected;                       // Admission control said no
+    uint64_t started[EDF_BENCH_JOBS];    // TSC when each job got the CPU
+    uint64_t start;                      // TSC at the first release
+    uint64_t cycles_per_tick;
+} edf_bench_run_t;
+
+static edf_bench_run_t edf_bench_runs[2];
+static volatile bool edf_bench_stop;
+static volatile uint32_t edf_bench_sink;
+
+/**
+ * demo_calc_process's arithmetic, repeated until the benchmark ends
+ */
+static void edf_bench_hog(void *arg)
+{
+    (void)arg;
+    uint32_t result = 0;
+    while (!edf_bench_stop)
+    {
+        for (uint32_t i = 0; i < 500000 && !edf_bench_stop; i++)
+        {
+            result += i * 2;
+            if (result > 1000000)
+            {
+                result = result % 1000000;
+            }
+        }
+    }
+    edf_bench_sink = result;
+}
+
+/**
+ * Spin to the next tick edge and return the TSC there
+ */
+static uint64_t edf_bench_tick_edge(void)
+{
+    uint32_t tick = timer_get_ticks();
+    while (timer_get_ticks() == tick)
+    {
+        asm volatile("pause");
+    }
+    return rdtsc();
+}
+
+/**
+ * The periodic task: released every EDF_BENCH_PERIOD ticks from a tick
+ * edge, it notes when each job actually gets the CPU, does a little work
+ * and waits for its next release
+ */
+static void edf_bench_periodic(void *arg)
+{
+    edf_bench_run_t *run = arg;
+
+    run->start = edf_bench_tick_edge();
+    uint32_t release = timer_get_ticks();
+    if (run->deadline && scheduler_set_deadline(EDF_BENCH_RUNTIME, 0, EDF_BENCH_PERIOD) != PROCESS_SUCCESS)
+    {
+        run->rejected = true;
+        return;
+    }
+
+    for (uint32_t job = 0; job < EDF_BENCH_JOBS; job++)
+    {
+        release += EDF_BENCH_PERIOD;
+        if (run->deadline)
+        {
+            scheduler_wait_period();
+        }
+        else
+        {
+            uint32_t now = timer_get_ticks();
+            if ((int32_t)(release - now) > 0)
+                timer_sleep(release - now);
+        }
+        run->started[job] = rdtsc();
+
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < EDF_BENCH_WORK; i++)
+        {
+            result += i * 2;
+        }
+        edf_bench_sink = result;
+    }
+
+    uint64_t end = edf_bench_tick_edge();
+    run->cycles_per_tick = (end - run->start) / (timer_get_ticks() - (release - EDF_BENCH_JOBS * EDF_BENCH_PERIOD));
+    scheduler_set_deadline(0, 0, 0);
+}
+
+/**
+ * Run the periodic task to completion next to EDF_BENCH_HOGS CPU hogs.
+ * Returns false if a thread could not be created.
+ */
+static bool edf_bench_run(edf_bench_run_t *run)
+{
+    process_t *hogs[EDF_BENCH_HOGS];
+    uint32_t count = 0;
+    bool ok = true;
+
+    edf_bench_stop = false;
+    for (; count < EDF_BENCH_HOGS; count++)
+    {
+        hogs[count] = kthread_create("hog", edf_bench_hog, NULL);
+        if (!hogs[count])
+            break;
+    }
+
+    process_t *task = count == EDF_BENCH_HOGS ? kthread_create("periodic", edf_bench_periodic, run) : NULL;
+    if (task)
+    {
+        kthread_join(task);
+    }
+    else
+    {
+        ok = false;
+    }
+
+    edf_bench_stop = true;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        kthread_join(hogs[i]);
+    }
+    return ok;
+}
+
+/**
+ * Print worst and mean lateness in microseconds, and how many jobs
+ * started after their deadline
+ */
+static void edf_bench_report(const char *label, edf_bench_run_t *run)
+{
+    uint64_t worst = 0, total = 0;
+    uint32_t missed = 0;
+    uint64_t period = run->cycles_per_tick * EDF_BENCH_PERIOD;
+
+    for (uint32_t job = 0; job < EDF_BENCH_JOBS; job++)
+    {
+        uint64_t release = run->start + period * (job + 1);
+        uint64_t late = run->started[job] > release ? run->started[job] - release : 0;
+
+        total += late;
+        if (late > worst)
+            worst = late;
+        if (late >= period)
+            missed++;
+    }
+
+    uint64_t cycles_per_us = run->cycles_per_tick / (1000000 / TIMER_FREQUENCY);
+    if (!cycles_per_us)
+        cycles_per_us = 1;
+
+    vga_print(label);
+    for (uint32_t i = strlen(label); i < 9; i++)
+    {
+        vga_putchar(' ');
+    }
+    bench_print_column((uint32_t)(worst / cycles_per_us), 12);
+    bench_print_column((uint32_t)(total / EDF_BENCH_JOBS / cycles_per_us), 11);
+    vga_print_dec(missed);
+    vga_print("\n");
+}
+
+/**
+ * Release a periodic task every EDF_BENCH_PERIOD ticks while CPU hogs
+ * compete for the processor, first as an ordinary process of the boot
+ * class and then with a deadline reservation, and compare how late its
+ * jobs get the CPU
+ */
+void bench_edf(void)
+{
+    if (!current_process)
+    {
+        vga_print("No current process to own the threads\n");
+        return;
+    }
+
+    vga_print("Periodic task: ");
+    vga_print_dec(EDF_BENCH_JOBS);
+    vga_print(" jobs, ");
+    vga_print_dec(EDF_BENCH_PERIOD);
+    vga_print("-tick period, ");
+    vga_print_dec(EDF_BENCH_HOGS);
+    vga_print(" CPU hogs\n");
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        memset(&edf_bench_runs[i], 0, sizeof(edf_bench_runs[i]));
+        edf_bench_runs[i].deadline = i == 1;
+        if (!edf_bench_run(&edf_bench_runs[i]))
+        {
+            vga_print("Out of PIDs or memory\n");
+            return;
+        }
+    }
+
+    if (edf_bench_runs[1].rejected)
+    {
+        vga_print("Deadline reservation rejected by admission control\n");
+        return;
+    }
+
+    vga_print("CLASS    WORST (us)  MEAN (us)  MISSED\n");
+    edf_bench_report(scheduler_class()->name, &edf_bench_runs[0]);
+    edf_bench_report("edf", &edf_bench_runs[1]);
+}
@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "kernel.h"
+
+// In-kernel microbenchmarks (run from the shell, timed with rdtsc)
+void bench_tlb(void);
+void bench_mem(void);
+void bench_str(void);
+void bench_context_switch(void);
+void bench_kthread(void);
+void bench_edf(void);
+
+#endif
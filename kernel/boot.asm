@@ -34,8 +34,11 @@ _start:
     ; Call the global constructors.
     ; call _init
 
-    ; Transfer control to the main kernel.
+    ; Transfer control to the main kernel, passing the multiboot
+    ; magic (EAX) and boot information pointer (EBX).
     extern kernel_main
+    push ebx
+    push eax
     call kernel_main
 
     ; If the kernel returns, hang in an infinite loop.
@@ -1,5 +1,10 @@
 #include "keyboard.h"
+#include "timer.h"
 #include "../kernel.h"
+#include "../proc/process.h"
+
+// IRQ 1 stub (interrupts.asm)
+extern void keyboard_interrupt_wrapper(void);
 
 // Global keyboard state
 static keyboard_state_t kb_state = {0};
@@ -28,6 +33,10 @@ void keyboard_init(void)
         kb_state.input_buffer[i] = 0;
     }
 
+    // Input is still polled; the interrupt only ends an idle halt
+    idt_set_gate(33, (uint32_t)keyboard_interrupt_wrapper, 0x08, 0x8E);
+    pic_unmask_irq(1);
+
     // IMPORTANT: Drain keyboard buffer completely to remove any garbage
     for (int i = 0; i < 100; i++)
     {
@@ -245,6 +254,24 @@ char *keyboard_get_input(void)
 
     while (1)
     {
+        // Nothing new from the controller and no key to repeat: with other
+        // processes runnable, sleep a tick so they run (a yield would hand
+        // the high-priority shell straight back the CPU) and poll again;
+        // otherwise halt until the next interrupt
+        if (!(inb(KEYBOARD_STATUS_PORT) & KEYBOARD_OUTPUT_FULL) && kb_state.held_key == 0 &&
+            kb_state.enter_cooldown == 0)
+        {
+            if (current_process && scheduler_get_next())
+            {
+                process_sleep(current_process, 1);
+            }
+            else
+            {
+                timer_idle(TIMER_NO_DEADLINE);
+            }
+            continue;
+        }
+
         // Poll keyboard port for input
         uint8_t scancode = inb(KEYBOARD_DATA_PORT);
 
@@ -6,6 +6,7 @@
 // Keyboard configuration constants
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
+#define KEYBOARD_OUTPUT_FULL 0x01 // Status: a byte is waiting in the data port
 
 // Scancode definitions
 #define ENTER_SCANCODE 0x1C
@@ -1,18 +1,80 @@
+/* PIT Timer
+ *
+ * Channel 0 runs as a periodic rate generator at TIMER_FREQUENCY while
+ * the CPU is busy. When it goes idle, timer_idle() replaces the periodic
+ * tick with a single one-shot count for the next deadline (a sleeping
+ * process, or the caller's own) and halts; on wake-up the ticks that
+ * passed are read back from the counter and the periodic tick resumes
+ * in phase. The 16-bit counter limits one shot to about 55ms, so a long
+ * idle period is a chain of shots rather than 100 ticks a second.
+ *
+ * Sleeping processes and other kernel timers wait on the timing wheel
+ * (timer_wheel.c), which runs from here on every tick and after every
+ * tickless stretch, and supplies the next deadline for the one-shot.
+ */
+
 #include "timer.h"
+#include "timer_wheel.h"
 #include "../kernel.h"
 #include "../proc/process.h"
 
 // Assembly wrapper for timer interrupt (defined in interrupts.asm)
 extern void timer_interrupt_wrapper(void);
 
-static uint32_t timer_ticks = 0;
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND 0x43
+#define PIT_PERIODIC 0x34 // Channel 0, lobyte/hibyte, mode 2 (rate generator)
+#define PIT_ONESHOT 0x30  // Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define PIT_LATCH 0x00    // Latch channel 0's count
+#define PIT_MAX_COUNT 0xFFFF
+
+static volatile uint32_t timer_ticks = 0;
+
+// Idle one-shot state, shared with the interrupt handler
+static volatile bool timer_oneshot_active = false;
+static volatile bool timer_oneshot_fired = false;
+
+// Statistics
+static uint32_t timer_periodic_ticks = 0;
+static uint32_t timer_idle_halts = 0;
+static uint32_t timer_oneshots = 0;
+static uint64_t timer_tickless_counts = 0; // PIT counts spent halted in one-shot mode
+
+static void pit_program(uint8_t mode, uint32_t count)
+{
+    outb(PIT_COMMAND, mode);
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+static uint32_t pit_read_count(void)
+{
+    outb(PIT_COMMAND, PIT_LATCH);
+    uint32_t low = inb(PIT_CHANNEL0);
+    uint32_t high = inb(PIT_CHANNEL0);
+    return (high << 8) | low;
+}
 
 /**
  * Timer interrupt handler
  */
 void timer_handler(void)
 {
+    scheduler_idle_end();
+    uint64_t start = rdtsc();
+
+    if (timer_oneshot_active)
+    {
+        // The idle one-shot expired; timer_idle() accounts for the time
+        timer_oneshot_active = false;
+        timer_oneshot_fired = true;
+        return;
+    }
+
     timer_ticks++;
+    timer_periodic_ticks++;
+    timer_wheel_run(timer_ticks);
+    scheduler_account_irq(rdtsc() - start);
 
     // Call scheduler every timer tick for preemptive multitasking
     scheduler_tick();
@@ -25,18 +87,12 @@ void timer_init(void)
 {
     vga_print("  Initializing timer (PIT)...\n");
 
-    // Calculate divisor for desired frequency
-    uint32_t divisor = 1193180 / TIMER_FREQUENCY;
-
-    // Send command byte to PIT
-    outb(0x43, 0x36); // Channel 0, lobyte/hibyte, rate generator
-
-    // Send divisor
-    outb(0x40, divisor & 0xFF);        // Low byte
-    outb(0x40, (divisor >> 8) & 0xFF); // High byte
+    timer_wheel_init(timer_ticks + 1);
+    pit_program(PIT_PERIODIC, TIMER_DIVISOR);
 
     // Install timer handler in IDT (IRQ 0 = interrupt 32)
     idt_set_gate(32, (uint32_t)timer_interrupt_wrapper, 0x08, 0x8E);
+    pic_unmask_irq(0);
 
     vga_print("  Timer initialized at ");
     vga_print_hex(TIMER_FREQUENCY);
@@ -52,14 +108,134 @@ uint32_t timer_get_ticks(void)
 }
 
 /**
- * Sleep for specified number of timer ticks
+ * Halt until the next interrupt or `deadline` (an absolute tick, or
+ * TIMER_NO_DEADLINE), whichever comes first. Only a truly idle CPU stops
+ * the periodic tick: with anything due within the current tick, or any
+ * process runnable, it halts on the periodic tick so the scheduler can
+ * still preempt into waiting work.
+ */
+void timer_idle(uint32_t deadline)
+{
+    uint32_t flags = irq_save();
+
+    uint32_t next = timer_wheel_next_expiry();
+    if (deadline != TIMER_NO_DEADLINE && (next == TIMER_NO_DEADLINE || (int32_t)(deadline - next) < 0))
+    {
+        next = deadline;
+    }
+
+    timer_idle_halts++;
+    uint32_t now = timer_ticks;
+
+    if ((next != TIMER_NO_DEADLINE && (int32_t)(next - now) <= 1) || pic_irq_pending(0) || scheduler_get_next())
+    {
+        // Due by the next tick anyway, a tick is already pending, or the
+        // CPU is not idle at all: let the periodic tick wake us
+        scheduler_idle_begin();
+        asm volatile("sti; hlt; cli");
+        scheduler_idle_end();
+    }
+    else
+    {
+        // Counts since the last tick, then a one-shot up to the deadline
+        uint32_t phase = TIMER_DIVISOR - pit_read_count();
+        uint32_t count = PIT_MAX_COUNT;
+        if (next != TIMER_NO_DEADLINE && next - now <= PIT_MAX_COUNT / TIMER_DIVISOR)
+        {
+            count = (next - now) * TIMER_DIVISOR - phase;
+        }
+
+        timer_oneshot_fired = false;
+        timer_oneshot_active = true;
+        pit_program(PIT_ONESHOT, count);
+        timer_oneshots++;
+
+        scheduler_idle_begin();
+        asm volatile("sti; hlt; cli");
+        scheduler_idle_end();
+
+        // Woken by the one-shot or by another interrupt (e.g. a key press);
+        // a count that wrapped past zero means the shot is just pending
+        uint32_t left = pit_read_count();
+        uint32_t elapsed = (timer_oneshot_fired || left > count) ? count : count - left;
+        timer_oneshot_active = false;
+        timer_tickless_counts += elapsed;
+
+        phase += elapsed;
+        timer_ticks += phase / TIMER_DIVISOR;
+        phase %= TIMER_DIVISOR;
+
+        // Resume the periodic tick in phase: a short first period, then
+        // the full divisor from the next reload on
+        uint32_t first = TIMER_DIVISOR - phase;
+        pit_program(PIT_PERIODIC, first < 2 ? 2 : first);
+        outb(PIT_CHANNEL0, TIMER_DIVISOR & 0xFF);
+        outb(PIT_CHANNEL0, (TIMER_DIVISOR >> 8) & 0xFF);
+
+        // Catch up on the timers that fell due while the tick was off
+        timer_wheel_run(timer_ticks);
+    }
+
+    irq_restore(flags);
+}
+
+/**
+ * Sleep for specified number of timer ticks. A process blocks on its
+ * sleep timer; before there are processes, the CPU idles until the end.
  */
 void timer_sleep(uint32_t ticks)
 {
-    uint32_t start_ticks = timer_ticks;
-    while (timer_ticks < start_ticks + ticks)
+    if (current_process)
     {
-        // Busy wait - in real OS would yield to other processes
-        asm volatile("nop");
+        process_sleep(current_process, ticks);
+        return;
     }
+
+    uint32_t end = timer_ticks + ticks;
+    while ((int32_t)(timer_ticks - end) < 0)
+    {
+        timer_idle(end);
+    }
+}
+
+void timer_print_stats(void)
+{
+    vga_print("Ticks: ");
+    vga_print_dec(timer_ticks);
+    vga_print(" (");
+    vga_print_dec(timer_periodic_ticks);
+    vga_print(" periodic interrupts)\nIdle halts: ");
+    vga_print_dec(timer_idle_halts);
+    vga_print(", tickless: ");
+    vga_print_dec(timer_oneshots);
+    vga_print(" one-shots, ");
+    vga_print_dec((uint32_t)(timer_tickless_counts * 1000 / TIMER_PIT_HZ));
+    vga_print("ms\n");
+    timer_wheel_print_stats();
+}
+
+/**
+ * Interrupt and PIT state for the `status` command
+ */
+void timer_print_status(void)
+{
+    uint32_t flags = irq_save();
+    bool oneshot = timer_oneshot_active;
+    irq_restore(flags);
+
+    vga_print("  Interrupts: ");
+    vga_print(flags & 0x200 ? "Enabled" : "Masked (taken while halted)"); // EFLAGS.IF
+    vga_print(", timer IRQ ");
+    vga_print(pic_irq_unmasked(0) ? "on" : "off");
+    vga_print(", keyboard IRQ ");
+    vga_print(pic_irq_unmasked(1) ? "on" : "off");
+    vga_print("\n");
+
+    vga_print("  Timer: ");
+    vga_print(oneshot ? "one-shot (tickless idle)" : "periodic");
+    vga_print(" at ");
+    vga_print_dec(TIMER_FREQUENCY);
+    vga_print(" Hz, ");
+    vga_print_dec(timer_oneshots);
+    vga_print(" tickless one-shots\n");
 }
@@ -5,11 +5,17 @@
 
 // Timer frequency (Hz)
 #define TIMER_FREQUENCY 100 // 100 Hz = 10ms intervals
+#define TIMER_PIT_HZ 1193180
+#define TIMER_DIVISOR (TIMER_PIT_HZ / TIMER_FREQUENCY)
+#define TIMER_NO_DEADLINE 0xFFFFFFFF
 
 // Timer functions
 void timer_init(void);
 void timer_handler(void);
 uint32_t timer_get_ticks(void);
 void timer_sleep(uint32_t ticks);
+void timer_idle(uint32_t deadline);
+void timer_print_stats(void);
+void timer_print_status(void);
 
 #endif
@@ -0,0 +1,260 @@
+/* Hierarchical Timing Wheel
+ *
+ * Pending kernel timers hang in unsorted slot lists, so adding and
+ * cancelling a timer are O(1) however many are outstanding. A timer due
+ * within TIMER_WHEEL_ROOT_SIZE ticks sits in the root slot of its exact
+ * tick; later ones go to a coarser level whose slots each cover a full
+ * turn of the level below. Each tick runs one root slot; whenever the
+ * root wraps, one slot of the next level is cascaded down (and so on up
+ * the levels), re-filing its timers by their remaining time. A tick
+ * therefore only touches the timers that expire in it, plus an amortised
+ * share of the cascades.
+ */
+
+#include "timer_wheel.h"
+#include "timer.h"
+
+#define ROOT_MASK (TIMER_WHEEL_ROOT_SIZE - 1)
+#define LEVEL_MASK (TIMER_WHEEL_LEVEL_SIZE - 1)
+#define LEVEL_SHIFT(level) (TIMER_WHEEL_ROOT_BITS + (level) * TIMER_WHEEL_LEVEL_BITS)
+
+static ktimer_t *wheel_root[TIMER_WHEEL_ROOT_SIZE];
+static ktimer_t *wheel_levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+static uint32_t wheel_time = 0; // Next tick to run
+
+// Statistics
+static uint32_t wheel_pending = 0;
+static uint32_t wheel_expired = 0;
+static uint32_t wheel_cascaded = 0;
+
+static void slot_insert(ktimer_t **slot, ktimer_t *timer)
+{
+    timer->next = *slot;
+    if (*slot)
+        (*slot)->pprev = &timer->next;
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+static void slot_remove(ktimer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * File a timer by how far its expiry is from wheel_time
+ */
+static void wheel_insert(ktimer_t *timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - wheel_time;
+
+    if ((int32_t)delta < 0)
+    {
+        // Already due: run it on the next tick
+        slot_insert(&wheel_root[wheel_time & ROOT_MASK], timer);
+        return;
+    }
+
+    if (delta < TIMER_WHEEL_ROOT_SIZE)
+    {
+        slot_insert(&wheel_root[expires & ROOT_MASK], timer);
+        return;
+    }
+
+    uint32_t level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1u << LEVEL_SHIFT(level + 1)))
+    {
+        level++;
+    }
+    slot_insert(&wheel_levels[level][(expires >> LEVEL_SHIFT(level)) & LEVEL_MASK], timer);
+}
+
+/**
+ * Re-file every timer of one slot of a level. Returns the slot index.
+ */
+static uint32_t wheel_cascade(uint32_t level)
+{
+    uint32_t index = (wheel_time >> LEVEL_SHIFT(level)) & LEVEL_MASK;
+    ktimer_t *timer = wheel_levels[level][index];
+    wheel_levels[level][index] = NULL;
+
+    while (timer)
+    {
+        ktimer_t *next = timer->next;
+        wheel_insert(timer);
+        wheel_cascaded++;
+        timer = next;
+    }
+
+    return index;
+}
+
+void timer_wheel_init(uint32_t now)
+{
+    for (int i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++)
+    {
+        wheel_root[i] = NULL;
+    }
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        for (int i = 0; i < TIMER_WHEEL_LEVEL_SIZE; i++)
+        {
+            wheel_levels[level][i] = NULL;
+        }
+    }
+    wheel_time = now;
+    wheel_pending = 0;
+}
+
+void ktimer_init(ktimer_t *timer, ktimer_fn_t fn, void *data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->data = data;
+}
+
+/**
+ * Arm a timer for absolute tick `expires`, moving it if already pending
+ */
+void ktimer_add(ktimer_t *timer, uint32_t expires)
+{
+    uint32_t flags = irq_save();
+
+    if (ktimer_pending(timer))
+    {
+        slot_remove(timer);
+        wheel_pending--;
+    }
+
+    timer->expires = expires;
+    wheel_insert(timer);
+    wheel_pending++;
+
+    irq_restore(flags);
+}
+
+/**
+ * Disarm a timer. Returns false if it was not pending.
+ */
+bool ktimer_cancel(ktimer_t *timer)
+{
+    uint32_t flags = irq_save();
+    bool pending = ktimer_pending(timer);
+
+    if (pending)
+    {
+        slot_remove(timer);
+        wheel_pending--;
+    }
+
+    irq_restore(flags);
+    return pending;
+}
+
+/**
+ * Run every timer due up to and including tick `now`. Called with
+ * interrupts off, from the timer interrupt or after a tickless idle.
+ */
+void timer_wheel_run(uint32_t now)
+{
+    while ((int32_t)(now - wheel_time) >= 0)
+    {
+        uint32_t index = wheel_time & ROOT_MASK;
+
+        // The root wrapped: pull the next slot of each level down, going
+        // up a level only when this one wrapped too
+        if (index == 0)
+        {
+            for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+            {
+                if (wheel_cascade(level) != 0)
+                    break;
+            }
+        }
+
+        // Detach the slot first: callbacks may re-arm timers for this tick,
+        // which then land in the next one
+        ktimer_t *expired = wheel_root[index];
+        wheel_root[index] = NULL;
+        if (expired)
+            expired->pprev = &expired;
+        wheel_time++;
+
+        while (expired)
+        {
+            ktimer_t *timer = expired;
+            slot_remove(timer);
+            wheel_pending--;
+            wheel_expired++;
+            timer->fn(timer->data);
+        }
+    }
+}
+
+/**
+ * Earliest tick at which a pending timer may need attention, or
+ * TIMER_NO_DEADLINE. Exact for the root; for a coarser level it is the
+ * tick its slot cascades, which is never later than its timers. Costs a
+ * fixed number of slot checks, independent of how many timers there are.
+ */
+uint32_t timer_wheel_next_expiry(void)
+{
+    if (!wheel_pending)
+        return TIMER_NO_DEADLINE;
+
+    uint32_t best = TIMER_NO_DEADLINE;
+    uint32_t best_delta = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++)
+    {
+        if (wheel_root[(wheel_time + i) & ROOT_MASK])
+        {
+            best = wheel_time + i;
+            best_delta = i;
+            break;
+        }
+    }
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint32_t shift = LEVEL_SHIFT(level);
+        uint32_t base = wheel_time >> shift;
+
+        for (uint32_t k = 0; k <= TIMER_WHEEL_LEVEL_SIZE; k++)
+        {
+            uint32_t cascade = (base + k) << shift;
+            if ((int32_t)(cascade - wheel_time) < 0)
+                continue; // This slot's next cascade is a full turn away
+
+            if (wheel_levels[level][(base + k) & LEVEL_MASK])
+            {
+                if (cascade - wheel_time < best_delta)
+                {
+                    best = cascade;
+                    best_delta = cascade - wheel_time;
+                }
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+void timer_wheel_print_stats(void)
+{
+    vga_print("Timers: ");
+    vga_print_dec(wheel_pending);
+    vga_print(" pending, ");
+    vga_print_dec(wheel_expired);
+    vga_print(" expired, ");
+    vga_print_dec(wheel_cascaded);
+    vga_print(" cascaded\n");
+}
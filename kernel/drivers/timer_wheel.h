@@ -0,0 +1,41 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "kernel.h"
+
+// Wheel geometry: 256 one-tick slots, then four levels of 64 slots,
+// each slot of a level spanning a whole turn of the level below
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// Callback run from the timer interrupt when a timer expires
+typedef void (*ktimer_fn_t)(void *data);
+
+// Kernel timer; embed it in the owning object
+typedef struct ktimer
+{
+    struct ktimer *next;
+    struct ktimer **pprev; // Link that points at this timer; NULL while idle
+    uint32_t expires; // Absolute tick
+    ktimer_fn_t fn;
+    void *data;
+} ktimer_t;
+
+void ktimer_init(ktimer_t *timer, ktimer_fn_t fn, void *data);
+void ktimer_add(ktimer_t *timer, uint32_t expires);
+bool ktimer_cancel(ktimer_t *timer);
+
+static inline bool ktimer_pending(ktimer_t *timer)
+{
+    return timer->pprev != NULL;
+}
+
+void timer_wheel_init(uint32_t now);
+void timer_wheel_run(uint32_t now);
+uint32_t timer_wheel_next_expiry(void);
+void timer_wheel_print_stats(void);
+
+#endif
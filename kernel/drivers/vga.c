@@ -171,3 +171,18 @@ void vga_print_hex(uint32_t value)
 
     vga_print(buffer);
 }
+
+void vga_print_dec(uint32_t value)
+{
+    char buffer[11]; // Up to 10 decimal digits + null terminator
+    int pos = 10;
+    buffer[pos] = '\0';
+
+    do
+    {
+        buffer[--pos] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    vga_print(&buffer[pos]);
+}
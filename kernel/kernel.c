@@ -6,7 +6,19 @@
 #include "drivers/keyboard.h"
 #include "drivers/timer.h"
 #include "proc/process.h"
+#include "proc/sched.h"
+#include "proc/kthread.h"
 #include "syscalls.h"
+#include "multiboot.h"
+#include "mem/pmm.h"
+#include "mem/slab.h"
+#include "mem/stack_pool.h"
+#include "mem/vmm.h"
+#include "bench.h"
+#include "arch/gdt.h"
+#include "arch/cpu.h"
+#include "arch/fpu.h"
+#include "log.h"
 
 // Simple serial output for debugging
 void serial_write_char(char c)
@@ -25,6 +37,32 @@ void serial_write_string(const char *str)
     }
 }
 
+void serial_write_dec(uint32_t value)
+{
+    char buffer[11]; // Up to 10 decimal digits + null terminator
+    int pos = 10;
+    buffer[pos] = '\0';
+
+    do
+    {
+        buffer[--pos] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    serial_write_string(&buffer[pos]);
+}
+
+void serial_write_hex(uint32_t value)
+{
+    const char hex_chars[] = "0123456789ABCDEF";
+
+    serial_write_string("0x");
+    for (int i = 7; i >= 0; i--)
+    {
+        serial_write_char(hex_chars[(value >> (i * 4)) & 0xF]);
+    }
+}
+
 // Converts a string to uint32_t, returns 1 on success, 0 on failure
 int string_to_uint32(const char *str, uint32_t *out)
 {
@@ -43,6 +81,57 @@ int string_to_uint32(const char *str, uint32_t *out)
     return (i > 0);
 }
 
+// Kernel command line, copied before the frame allocator can reuse it
+#define CMDLINE_MAX 256
+static char kernel_cmdline[CMDLINE_MAX];
+
+static void cmdline_init(uint32_t magic, multiboot_info_t *mbi)
+{
+    kernel_cmdline[0] = '\0';
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !mbi || !(mbi->flags & MULTIBOOT_INFO_CMDLINE))
+        return;
+
+    const char *cmdline = (const char *)mbi->cmdline;
+    uint32_t i;
+    for (i = 0; i < CMDLINE_MAX - 1 && cmdline[i]; i++)
+    {
+        kernel_cmdline[i] = cmdline[i];
+    }
+    kernel_cmdline[i] = '\0';
+}
+
+/**
+ * Look up a name=value option on the kernel command line and copy its
+ * value (up to `size` - 1 characters). Returns false if it is absent.
+ */
+bool cmdline_get(const char *name, char *value, uint32_t size)
+{
+    uint32_t name_len = strlen(name);
+    const char *option = kernel_cmdline;
+
+    while (*option)
+    {
+        const char *end = option;
+        while (*end && *end != ' ')
+            end++;
+
+        if (strncmp(option, name, name_len) == 0 && option[name_len] == '=')
+        {
+            const char *start = option + name_len + 1;
+            uint32_t len = end - start;
+            if (len >= size)
+                len = size - 1;
+            memcpy(value, start, len);
+            value[len] = '\0';
+            return true;
+        }
+
+        option = *end ? end + 1 : end;
+    }
+
+    return false;
+}
+
 // Forward declarations
 void show_welcome_screen(void);
 void interactive_shell(void);
@@ -79,22 +168,36 @@ void change_current_process(uint32_t pid)
 }
 process_t *process_create_test(const char *name, void *entry_point, process_priority_t priority);
 
-// Kernel main function
-void kernel_main(void)
+// Kernel main function, entered from boot.asm with the multiboot handoff
+void kernel_main(uint32_t magic, multiboot_info_t *mbi)
 {
     // Initialize VGA driver first
     vga_init();
     vga_clear();
+    cmdline_init(magic, mbi);
 
     serial_write_string("SERIAL: Kernel started\n");
     vga_print("SimpleOS Kernel Starting...\n");
 
     // Initialize subsystems quietly
+    vga_print("Initializing CPU features...\n");
+    cpu_init();
+
+    vga_print("Initializing physical memory...\n");
+    pmm_init(magic, mbi);
+
     vga_print("Initializing memory...\n");
     memory_init();
 
+    vga_print("Initializing paging...\n");
+    vmm_init();
+
+    vga_print("Initializing GDT...\n");
+    gdt_init();
+
     vga_print("Initializing IDT...\n");
     idt_init();
+    fpu_init(); // Lazy FPU/SSE switching through #NM
 
     vga_print("Initializing timer...\n");
     timer_init(); // Initialize timer for preemptive scheduling
@@ -115,7 +218,7 @@ void kernel_main(void)
     // Show welcome screen
     show_welcome_screen();
 
-    vga_print("DEBUG: Welcome screen shown, starting shell...\n");
+    LOG_DEBUG("kernel", "Welcome screen shown, starting shell\n");
 
     // Small delay to let welcome screen render
     for (volatile int i = 0; i < 1000000; i++)
@@ -134,7 +237,7 @@ void kernel_main(void)
 void show_welcome_screen(void)
 {
     serial_write_string("SERIAL: Starting welcome screen function\n");
-    vga_print("DEBUG: Starting welcome screen function\n");
+    LOG_DEBUG("kernel", "Starting welcome screen function\n");
 
     // Simple title
     vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
@@ -150,7 +253,7 @@ void show_welcome_screen(void)
     vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     vga_print("Try any command!\n\n");
 
-    vga_print("DEBUG: Welcome screen completed\n");
+    LOG_DEBUG("kernel", "Welcome screen completed\n");
 }
 
 void interactive_shell(void)
@@ -160,6 +263,10 @@ void interactive_shell(void)
 
     while (1)
     {
+        // The shell is the kernel process, so waiting for input is our idle time
+        while (process_idle_work())
+            ;
+
         print_prompt();
         char *command = keyboard_get_input(); // Use new keyboard system
 
@@ -191,20 +298,35 @@ void process_command(char *command)
         vga_print("  about    - About SimpleOS\n");
         vga_print("  status   - System status\n");
         vga_print("  memory   - Memory information\n");
+        vga_print("  slabinfo - Slab cache statistics\n");
+        vga_print("  fpu      - Lazy FPU switching statistics\n");
+        vga_print("  heapprof [n]    - Dump top n heap allocators to serial\n");
+        vga_print("  stackpool [n]   - Stack pool statistics (n: set high-water mark)\n");
         vga_print("  clear    - Clear screen\n");
         vga_print("  version  - Show version info\n");
         vga_print("  keytest  - Test enhanced keyboard features\n");
         vga_print("  ps       - List all processes\n");
         vga_print("  proc     - Current process info\n");
+        vga_print("  top      - Live CPU usage per process\n");
         vga_print("  spawn <name>    - Create process with name\n");
         vga_print("  pkill <pid>     - Kill process by PID\n");
         vga_print("                    (Note: PID 1 kernel_idle is protected)\n");
         vga_print("  pstatus <pid> <status> - Set process status (READY/PAUSED/WAITING)\n");
-        vga_print("  fork            - Fork current process\n");
+        vga_print("  fork            - Run a process that forks a copy-on-write child\n");
+        vga_print("  wait            - Reap exited children of the shell\n");
         vga_print("  exec <prog>     - Execute program\n");
         vga_print("  getpid          - Get current process ID\n");
         vga_print("  schedule        - Trigger manual scheduler\n");
+        vga_print("  timer           - Tick count, tickless idle and timer statistics\n");
+        vga_print("  sleep <ticks>   - Block the shell on a wheel timer\n");
+        vga_print("  sched [latency|granularity <ms>] - Scheduler statistics and CFS tunables\n");
         vga_print("  sysinfo         - Show system protection info\n");
+        vga_print("  tlbbench        - Time TLB misses with 4KB vs 4MB pages\n");
+        vga_print("  membench        - Time memcpy/memset against byte loops\n");
+        vga_print("  strbench        - Time strlen/strcmp against byte loops\n");
+        vga_print("  ctxbench        - Time a ping-pong context switch\n");
+        vga_print("  kthreadbench    - Time kernel thread against process creation\n");
+        vga_print("  edfbench        - Periodic task lateness among CPU hogs, with and without a deadline\n");
     }
     else if (string_compare(command, "about"))
     {
@@ -223,8 +345,9 @@ void process_command(char *command)
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
         vga_print("  CPU Mode: 32-bit Protected Mode\n");
         vga_print("  Memory: Initialized\n");
+        vga_print(vmm_is_enabled() ? "  Paging: Enabled (4MB global kernel pages)\n" : "  Paging: Disabled\n");
         vga_print("  VGA: 80x25 Text Mode\n");
-        vga_print("  Interrupts: Disabled (safe mode)\n");
+        timer_print_status();
         vga_print("  Shell: Active\n");
     }
     else if (string_compare(command, "memory"))
@@ -232,43 +355,102 @@ void process_command(char *command)
         vga_set_color(VGA_COLOR_LIGHT_BROWN, VGA_COLOR_BLACK);
         vga_print("Memory Information:\n");
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-        vga_print("  Kernel loaded at: 0x1000\n");
-        vga_print("  Stack pointer: 0x90000\n");
-        vga_print("  VGA buffer: 0xB8000\n");
-        vga_print("  Available RAM: 128MB (QEMU)\n");
-        vga_print("  Heap start: 0x100000 (1MB)\n");
-        vga_print("  Heap size: 1MB\n");
-
-        // Calculate heap usage
-        extern uint8_t *heap_start, *heap_current, *heap_end;
-        uint32_t used = (uint32_t)heap_current - (uint32_t)heap_start;
-        uint32_t total = (uint32_t)heap_end - (uint32_t)heap_start;
-        uint32_t used_kb = used / 1024;
-        uint32_t total_kb = total / 1024;
+        pmm_stats_t pmm;
+        pmm_get_stats(&pmm);
 
-        vga_print("  Heap used: ");
-        if (used_kb < 10)
-        {
-            vga_putchar('0' + used_kb);
-        }
-        else
+        vga_print("  Kernel image: ");
+        vga_print_hex((uint32_t)kernel_start);
+        vga_print(" - ");
+        vga_print_hex((uint32_t)kernel_end);
+        vga_print("\n");
+        vga_print("  VGA buffer: 0xB8000\n");
+        vga_print("  Available RAM: ");
+        vga_print_dec(pmm.total_memory / 1024);
+        vga_print("KB\n");
+        vga_print("  Free frames: ");
+        vga_print_dec(pmm.free_frames);
+        vga_print(" / ");
+        vga_print_dec(pmm.total_frames);
+        vga_print(" (");
+        vga_print_dec(pmm.free_frames * 4);
+        vga_print("KB free)\n");
+        vga_print("  Free blocks by order:");
+        for (int order = 0; order <= PMM_MAX_ORDER; order++)
         {
-            vga_putchar('0' + (used_kb / 100));
-            vga_putchar('0' + ((used_kb / 10) % 10));
-            vga_putchar('0' + (used_kb % 10));
+            vga_print(" ");
+            vga_print_dec(pmm.free_blocks[order]);
         }
-        vga_print("KB / ");
-        if (total_kb < 10)
+        vga_print("\n");
+        // Report heap usage
+        heap_stats_t stats;
+        heap_get_stats(&stats);
+
+        vga_print("  Heap start: ");
+        vga_print_hex(stats.heap_start);
+        vga_print("\n");
+        vga_print("  Heap size: ");
+        vga_print_dec(stats.heap_size / 1024);
+        vga_print("KB in ");
+        vga_print_dec(stats.segments);
+        vga_print(" segment(s)\n");
+
+        vga_print("  Heap live: ");
+        vga_print_dec(stats.live_bytes);
+        vga_print(" bytes in ");
+        vga_print_dec(stats.live_allocations);
+        vga_print(" blocks\n");
+        vga_print("  Heap free: ");
+        vga_print_dec(stats.free_bytes);
+        vga_print(" bytes (largest block ");
+        vga_print_dec(stats.largest_free);
+        vga_print(")\n");
+        vga_print("  Heap fragmented: ");
+        vga_print_dec(stats.fragmented_bytes);
+        vga_print(" bytes\n");
+        vga_print("  Pre-zeroed: ");
+        vga_print_dec(pmm.zeroed_frames);
+        vga_print(" frames, ");
+        vga_print_dec(stats.zeroed_bytes);
+        vga_print(" heap bytes\n");
+    }
+    else if (string_compare(command, "slabinfo"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_BROWN, VGA_COLOR_BLACK);
+        vga_print("Slab Caches:\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        slab_print_stats();
+    }
+    else if (string_compare(command, "fpu"))
+    {
+        fpu_print_stats();
+    }
+    else if (string_compare(command, "stackpool") || string_starts_with(command, "stackpool "))
+    {
+        uint32_t high_water;
+        if (command[9] == ' ')
         {
-            vga_putchar('0' + total_kb);
+            if (!string_to_uint32(command + 10, &high_water))
+            {
+                vga_print("Usage: stackpool [n]\n");
+                return;
+            }
+            stack_pool_set_high_water_all(high_water);
         }
-        else
+
+        vga_set_color(VGA_COLOR_LIGHT_BROWN, VGA_COLOR_BLACK);
+        vga_print("Stack Pools:\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        stack_pool_print_stats();
+    }
+    else if (string_compare(command, "heapprof") || string_starts_with(command, "heapprof "))
+    {
+        uint32_t top_sites = 10;
+        if (command[8] == ' ' && !string_to_uint32(command + 9, &top_sites))
         {
-            vga_putchar('0' + (total_kb / 100));
-            vga_putchar('0' + ((total_kb / 10) % 10));
-            vga_putchar('0' + (total_kb % 10));
+            vga_print("Usage: heapprof [n]\n");
+            return;
         }
-        vga_print("KB\n");
+        heap_profile_dump(top_sites);
     }
     else if (string_compare(command, "clear"))
     {
@@ -567,17 +749,49 @@ void process_command(char *command)
             vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
         }
     }
+    else if (string_compare(command, "top"))
+    {
+        process_top();
+    }
+    else if (string_compare(command, "wait"))
+    {
+        // The shell must stay responsive, so it only reaps what has exited
+        uint32_t status;
+        uint32_t reaped = 0;
+        uint32_t pid;
+        while ((pid = sys_waitpid(-1, &status, WAIT_NOHANG)) != 0 && pid != (uint32_t)-1)
+        {
+            vga_print("Reaped PID ");
+            vga_print_dec(pid);
+            vga_print(", exit code ");
+            if ((int32_t)status < 0)
+            {
+                vga_putchar('-');
+                status = -status;
+            }
+            vga_print_dec(status);
+            vga_print("\n");
+            reaped++;
+        }
+
+        if (!reaped)
+        {
+            vga_print(pid == 0 ? "No child has exited yet\n" : "No children\n");
+        }
+    }
     else if (string_compare(command, "fork"))
     {
         vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-        vga_print("Forking current process...\n");
+        vga_print("Starting a process that forks...\n");
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
 
-        uint32_t child_pid = sys_fork();
-        if (child_pid > 0)
+        // The shell runs on the kernel stack and cannot fork itself; a
+        // process with its own address space can
+        process_t *forker = process_create("forker", (void *)demo_fork_process, PRIORITY_NORMAL);
+        if (forker)
         {
-            vga_print("Child process created with PID: ");
-            vga_print_hex(child_pid);
+            vga_print("Started forker with PID ");
+            vga_print_dec(forker->pid);
             vga_print("\n");
         }
         else
@@ -619,6 +833,51 @@ void process_command(char *command)
         vga_print("\n");
         vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
     }
+    else if (string_compare(command, "sched") || string_starts_with(command, "sched "))
+    {
+        // sched latency <ms> / sched granularity <ms> tune the CFS class
+        uint32_t value;
+        if (string_starts_with(command, "sched latency ") && string_to_uint32(command + 14, &value) && value)
+        {
+            cfs_latency_ms = value;
+        }
+        else if (string_starts_with(command, "sched granularity ") && string_to_uint32(command + 18, &value) && value)
+        {
+            cfs_min_granularity_ms = value;
+        }
+        else if (command[5] == ' ')
+        {
+            vga_print("Usage: sched [latency <ms> | granularity <ms>]\n");
+            return;
+        }
+
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Scheduler:\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        scheduler_print_stats();
+    }
+    else if (string_compare(command, "timer"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Timer:\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        timer_print_stats();
+    }
+    else if (string_starts_with(command, "sleep "))
+    {
+        uint32_t ticks;
+        if (!string_to_uint32(command + 6, &ticks))
+        {
+            vga_print("Usage: sleep <ticks>\n");
+            return;
+        }
+
+        uint32_t start = timer_get_ticks();
+        timer_sleep(ticks);
+        vga_print("Slept ");
+        vga_print_dec(timer_get_ticks() - start);
+        vga_print(" ticks\n");
+    }
     else if (string_compare(command, "schedule"))
     {
         vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
@@ -644,10 +903,54 @@ void process_command(char *command)
         vga_print("\n");
         vga_print("  Process Management:\n");
         vga_print("    - Maximum processes: 256\n");
-        vga_print("    - Static memory allocation for safety\n");
+        vga_print("    - PIDs: 1-32767, bitmap-allocated, reused last\n");
+        vga_print("    - Slab-allocated process control blocks\n");
         vga_print("    - Context switching with timer interrupts\n");
         vga_print("    - Preemptive scheduling at 100Hz\n");
     }
+    else if (string_compare(command, "strbench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running string benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_str();
+    }
+    else if (string_compare(command, "ctxbench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running context switch benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_context_switch();
+    }
+    else if (string_compare(command, "kthreadbench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running kernel thread benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_kthread();
+        kthread_print_stats();
+    }
+    else if (string_compare(command, "edfbench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running deadline scheduling benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_edf();
+    }
+    else if (string_compare(command, "membench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running memory benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_mem();
+    }
+    else if (string_compare(command, "tlbbench"))
+    {
+        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+        vga_print("Running TLB benchmark...\n");
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        bench_tlb();
+    }
     // Command to change process if pch <i>
     else if (command[0] == 'p' && command[1] == 'c' && command[2] == 'h' && command[3] == ' ' ){
         if (command[4] == 1)
@@ -685,53 +988,25 @@ void process_command(char *command)
 }
 
 // Utility functions
+// Shell string helpers, on top of the word-at-a-time libc routines
 int string_compare(const char *str1, const char *str2)
 {
-    int i = 0;
-    while (str1[i] && str2[i])
-    {
-        if (str1[i] != str2[i])
-        {
-            return 0;
-        }
-        i++;
-    }
-    return str1[i] == str2[i];
+    return strcmp(str1, str2) == 0;
 }
 
 int string_starts_with(const char *str, const char *prefix)
 {
-    int i = 0;
-    while (prefix[i])
-    {
-        if (str[i] != prefix[i])
-        {
-            return 0;
-        }
-        i++;
-    }
-    return 1;
+    return strncmp(str, prefix, strlen(prefix)) == 0;
 }
 
 void string_copy(char *dest, const char *src)
 {
-    int i = 0;
-    while (src[i])
-    {
-        dest[i] = src[i];
-        i++;
-    }
-    dest[i] = 0;
+    memcpy(dest, src, strlen(src) + 1);
 }
 
 int string_length(const char *str)
 {
-    int len = 0;
-    while (str[len])
-    {
-        len++;
-    }
-    return len;
+    return (int)strlen(str);
 }
 
 // Parse command arguments - returns number of arguments found
@@ -12,17 +12,57 @@ void vga_print(const char *str);
 void vga_print_hex(uint32_t value);
 void vga_putchar(char c);
 void vga_set_color(uint8_t foreground, uint8_t background);
+void vga_print_dec(uint32_t value);
 
 // Memory Management
+typedef struct
+{
+    uint32_t heap_start;       // Address of the first segment
+    uint32_t heap_size;        // Bytes managed by the heap, across all segments
+    uint32_t segments;         // Separate regions the heap has grown into
+    uint32_t live_bytes;       // Bytes requested by live allocations
+    uint32_t live_allocations; // Number of live allocations
+    uint32_t free_bytes;       // Bytes in free blocks and small-class lists
+    uint32_t largest_free;     // Largest single free block
+    uint32_t fragmented_bytes; // Free bytes outside the largest free block
+    uint32_t zeroed_bytes;     // Free bytes already zeroed by the idle task
+} heap_stats_t;
+
 void memory_init(void);
 void *kmalloc(size_t size);
+void *kmalloc_nozero(size_t size);
 void kfree(void *ptr);
+void heap_get_stats(heap_stats_t *stats);
+bool heap_prezero_step(void);
+void heap_profile_dump(uint32_t top_sites);
+
+// Allocation profiling (build with -DHEAP_PROFILE): tagged allocations are
+// accounted per subsystem; plain kmalloc() counts as "kernel"
+#ifdef HEAP_PROFILE
+void *kmalloc_tagged(size_t size, const char *tag);
+void *kmalloc_nozero_tagged(size_t size, const char *tag);
+#else
+#define kmalloc_tagged(size, tag) kmalloc(size)
+#define kmalloc_nozero_tagged(size, tag) kmalloc_nozero(size)
+#endif
 
 // Interrupt Handling
 void idt_init(void);
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags);
+void pic_unmask_irq(uint8_t irq);
+bool pic_irq_pending(uint8_t irq);
+bool pic_irq_unmasked(uint8_t irq);
 extern void idt_flush(uint32_t);
 
+// Kernel command line (name=value options)
+bool cmdline_get(const char *name, char *value, uint32_t size);
+
+// Serial port (COM1)
+void serial_write_char(char c);
+void serial_write_string(const char *str);
+void serial_write_dec(uint32_t value);
+void serial_write_hex(uint32_t value);
+
 // Keyboard Driver
 void keyboard_init(void);
 char keyboard_getchar(void);
@@ -41,11 +81,50 @@ static inline uint8_t inb(uint16_t port)
     return ret;
 }
 
+// CPU timestamp counter (cycles since reset)
+static inline uint64_t rdtsc(void)
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Mask interrupts around data shared with interrupt handlers
+static inline uint32_t irq_save(void)
+{
+    uint32_t flags;
+    asm volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags)
+{
+    asm volatile("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
 // String functions
 size_t strlen(const char *str);
 void *memset(void *ptr, int value, size_t size);
 void *memcpy(void *dest, const void *src, size_t size);
+void *memmove(void *dest, const void *src, size_t size);
+int memcmp(const void *ptr1, const void *ptr2, size_t size);
 int strcmp(const char *str1, const char *str2);
+int strncmp(const char *str1, const char *str2, size_t n);
+void *memchr(const void *ptr, int value, size_t size);
+char *strchr(const char *str, int value);
+
+// Bulk zeroing: a dword per store (rep stosd), then the byte tail
+static inline void memzero(void *ptr, size_t size)
+{
+    size_t dwords = size / 4;
+    asm volatile("rep stosl" : "+D"(ptr), "+c"(dwords) : "a"(0) : "memory");
+
+    uint8_t *tail = (uint8_t *)ptr;
+    for (size_t i = 0; i < (size & 3); i++)
+    {
+        tail[i] = 0;
+    }
+}
 
 // VGA Colors
 #define VGA_COLOR_BLACK 0
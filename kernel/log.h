@@ -0,0 +1,64 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "kernel.h"
+
+/* Kernel Logging
+ *
+ * LOG_<LEVEL>(subsystem, message) prints "[LEVEL subsystem] message".
+ * Messages above LOG_LEVEL are removed at compile time, arguments and all,
+ * so they cost nothing in a release build (make release).
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+static inline void log_write(const char *level, const char *subsystem, const char *message)
+{
+    vga_print("[");
+    vga_print(level);
+    vga_print(" ");
+    vga_print(subsystem);
+    vga_print("] ");
+    vga_print(message);
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(subsystem, message) log_write("ERROR", subsystem, message)
+#else
+#define LOG_ERROR(subsystem, message) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(subsystem, message) log_write("WARN", subsystem, message)
+#else
+#define LOG_WARN(subsystem, message) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(subsystem, message) log_write("INFO", subsystem, message)
+#else
+#define LOG_INFO(subsystem, message) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(subsystem, message) log_write("DEBUG", subsystem, message)
+#else
+#define LOG_DEBUG(subsystem, message) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(subsystem, message) log_write("TRACE", subsystem, message)
+#else
+#define LOG_TRACE(subsystem, message) ((void)0)
+#endif
+
+#endif
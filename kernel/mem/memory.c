@@ -1,78 +1,832 @@
-/* Basic Memory Management */
+/* Kernel Heap - Segregated-Fit Allocator
+ *
+ * Every block starts with an 8-byte header holding its size and flags.
+ * Free blocks also carry free-list links and a footer with their size, so
+ * kfree() can find and merge both neighbours in constant time (boundary
+ * tags). Free blocks are binned by floor(log2(size)); a bitmap of non-empty
+ * bins makes finding a large enough block O(1) for most requests.
+ *
+ * Requests up to HEAP_SMALL_MAX bytes are rounded up to a power-of-two size
+ * class. Freed small blocks are parked on a per-class list instead of being
+ * merged, which makes the common small kmalloc()/kfree() pair a list push/pop.
+ *
+ * The idle task pre-zeroes free blocks (heap_prezero_step). A zeroed free
+ * block is all zero except its links and footer, and splitting keeps the
+ * remainder zeroed, so kmalloc() from one only has to clear those few words.
+ *
+ * The heap starts right after the kernel image and frame metadata and grows
+ * on demand with frames from the physical allocator: in place when the
+ * frames above it are still free, otherwise as a new segment. Every segment
+ * ends in a used fence block, so merges never cross a segment boundary.
+ */
 
 #include "../kernel.h"
+#include "pmm.h"
 
-#define HEAP_START 0x100000 // 1MB
-#define HEAP_SIZE 0x100000  // 1MB heap
+#define HEAP_INITIAL_SIZE 0x40000 // 256KB at boot
+#define HEAP_GROW_MIN 0x10000     // Grow by at least 64KB at a time
 
-// Make these accessible for memory reporting
-uint8_t *heap_start = (uint8_t *)HEAP_START;
-uint8_t *heap_current = (uint8_t *)HEAP_START;
-uint8_t *heap_end = (uint8_t *)(HEAP_START + HEAP_SIZE);
+// Block header flags (kept in the low bits of the block size)
+#define BLOCK_USED 0x1      // Block is allocated or parked in a small-class list
+#define BLOCK_PREV_USED 0x2 // Previous block is in use (so it has no footer)
+#define BLOCK_SMALL 0x4     // Block belongs to a small size class
+#define BLOCK_FLAGS 0x7
 
-void memory_init(void)
+#define HEAP_ALIGN 8
+#define HEAP_HEADER_SIZE 8
+#define HEAP_MIN_BLOCK 24 // Header + free-list links + footer
+#define HEAP_MAX_REQUEST ((PAGE_SIZE << PMM_MAX_ORDER) - 2 * HEAP_HEADER_SIZE) // Fits one new segment
+
+// Small size classes: 16, 32, 64, 128 and 256 byte payloads
+#define HEAP_SMALL_SHIFT 4
+#define HEAP_SMALL_CLASSES 5
+#define HEAP_SMALL_MAX (1u << (HEAP_SMALL_SHIFT + HEAP_SMALL_CLASSES - 1))
+
+// Marks a small block that is sitting in its class list (catches double frees)
+#define HEAP_BLOCK_CACHED 0xFFFFFFFF
+
+// Marks a free block whose payload the idle task has already zeroed
+#define HEAP_BLOCK_ZEROED 0xFFFFFFFE
+#define HEAP_PREZERO_MIN 256 // Smaller blocks are cheap enough to clear on demand
+
+// Free bins, indexed by floor(log2(block size))
+#define HEAP_BINS 32
+
+typedef struct heap_block
 {
-    // Initialize heap - but be very careful
-    heap_current = heap_start;
+    uint32_t size_flags;          // Block size including header, plus BLOCK_* flags
+    uint32_t requested;           // Bytes requested by the caller (free: HEAP_BLOCK_ZEROED or 0)
+    struct heap_block *next_free; // Free-list links (only valid while free)
+    struct heap_block *prev_free;
+} heap_block_t;
+
+// Heap bounds: every segment lies within [heap_start, heap_end)
+uint8_t *heap_start = NULL;
+uint8_t *heap_end = NULL;
+static uint8_t *heap_top = NULL; // End of the newest segment, where in-place growth is tried
+static uint32_t heap_total_bytes;
+static uint32_t heap_segments;
 
-    // Don't clear heap memory - this might be causing issues
-    // memset(heap_start, 0, HEAP_SIZE);
+static heap_block_t *heap_bins[HEAP_BINS];
+static uint32_t heap_bin_bitmap;
+static heap_block_t *heap_small_lists[HEAP_SMALL_CLASSES];
 
-    // Just set up basic pointers
+// Running totals for heap_get_stats()
+static uint32_t heap_live_bytes;
+static uint32_t heap_live_allocations;
+static uint32_t heap_free_bytes;
+static uint32_t heap_cached_bytes;
+static uint32_t heap_zeroed_bytes;     // Bytes in pre-zeroed free blocks
+static uint32_t heap_unzeroed_blocks;  // Free blocks the idle task could zero
+
+static inline uint32_t block_size(heap_block_t *block)
+{
+    return block->size_flags & ~BLOCK_FLAGS;
 }
 
-// Functional memory allocator with tracking
-void *kmalloc(size_t size)
+static inline heap_block_t *block_next(heap_block_t *block)
 {
-    // Align to 4-byte boundary
-    size = (size + 3) & ~3;
+    return (heap_block_t *)((uint8_t *)block + block_size(block));
+}
 
-    // Add header for tracking allocations
-    size_t total_size = size + sizeof(size_t);
+static inline void block_set_footer(heap_block_t *block)
+{
+    *(uint32_t *)((uint8_t *)block + block_size(block) - sizeof(uint32_t)) = block_size(block);
+}
 
-    if (heap_current + total_size > heap_end)
+static inline uint32_t bin_index(uint32_t size)
+{
+    return 31 - __builtin_clz(size);
+}
+
+static inline uint32_t small_class(size_t size)
+{
+    if (size <= (1u << HEAP_SMALL_SHIFT))
+        return 0;
+    return (32 - __builtin_clz(size - 1)) - HEAP_SMALL_SHIFT;
+}
+
+static void bin_insert(heap_block_t *block)
+{
+    uint32_t idx = bin_index(block_size(block));
+
+    block->prev_free = NULL;
+    block->next_free = heap_bins[idx];
+    if (heap_bins[idx])
     {
-        // Out of memory - return NULL
-        return NULL;
+        heap_bins[idx]->prev_free = block;
+    }
+    heap_bins[idx] = block;
+
+    heap_bin_bitmap |= 1u << idx;
+    heap_free_bytes += block_size(block);
+
+    if (block->requested == HEAP_BLOCK_ZEROED)
+        heap_zeroed_bytes += block_size(block);
+    else if (block_size(block) >= HEAP_PREZERO_MIN)
+        heap_unzeroed_blocks++;
+}
+
+static void bin_remove(heap_block_t *block)
+{
+    uint32_t idx = bin_index(block_size(block));
+
+    if (block->prev_free)
+    {
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        heap_bins[idx] = block->next_free;
+    }
+
+    if (block->next_free)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+
+    if (!heap_bins[idx])
+    {
+        heap_bin_bitmap &= ~(1u << idx);
     }
+    heap_free_bytes -= block_size(block);
 
-    void *ptr = heap_current;
+    if (block->requested == HEAP_BLOCK_ZEROED)
+        heap_zeroed_bytes -= block_size(block);
+    else if (block_size(block) >= HEAP_PREZERO_MIN)
+        heap_unzeroed_blocks--;
+}
+
+/**
+ * Take a free block of at least `need` bytes out of the bins and mark it used.
+ * Any tail large enough to stand on its own is split off and re-binned.
+ * The block's `requested` field still says whether it was pre-zeroed.
+ */
+static heap_block_t *heap_take_block(uint32_t need)
+{
+    uint32_t idx = bin_index(need);
+    heap_block_t *block;
+
+    // Blocks in the exact bin may be smaller than needed, so check them
+    for (block = heap_bins[idx]; block; block = block->next_free)
+    {
+        if (block_size(block) >= need)
+            break;
+    }
+
+    // Every block in a higher bin is guaranteed to fit
+    if (!block)
+    {
+        uint32_t higher = heap_bin_bitmap & ~((2u << idx) - 1);
+        if (!higher)
+            return NULL; // Out of memory
+        block = heap_bins[__builtin_ctz(higher)];
+    }
+
+    bin_remove(block);
+
+    uint32_t size = block_size(block);
+    uint32_t prev_used = block->size_flags & BLOCK_PREV_USED;
+
+    if (size - need >= HEAP_MIN_BLOCK)
+    {
+        heap_block_t *rest = (heap_block_t *)((uint8_t *)block + need);
+        rest->size_flags = (size - need) | BLOCK_PREV_USED;
+        rest->requested = block->requested == HEAP_BLOCK_ZEROED ? HEAP_BLOCK_ZEROED : 0;
+        block_set_footer(rest);
+        bin_insert(rest);
+        size = need;
+    }
+    else
+    {
+        block_next(block)->size_flags |= BLOCK_PREV_USED;
+    }
 
-    // Store size in header for potential future free() implementation
-    *((size_t *)ptr) = size;
+    block->size_flags = size | BLOCK_USED | prev_used;
+    return block;
+}
+
+/**
+ * Return a block to the bins, merging it with free neighbours
+ */
+static void heap_release_block(heap_block_t *block)
+{
+    uint32_t size = block_size(block);
+    heap_block_t *next = block_next(block);
+
+    if (!(next->size_flags & BLOCK_USED))
+    {
+        bin_remove(next);
+        size += block_size(next);
+    }
+
+    if (!(block->size_flags & BLOCK_PREV_USED))
+    {
+        uint32_t prev_size = *((uint32_t *)block - 1);
+        heap_block_t *prev = (heap_block_t *)((uint8_t *)block - prev_size);
+        bin_remove(prev);
+        size += prev_size;
+        block = prev;
+    }
+
+    // Free blocks never touch, so whatever precedes a merged block is in use
+    block->size_flags = size | BLOCK_PREV_USED;
+    block->requested = 0; // Not zeroed (freed payloads are poisoned)
+    block_set_footer(block);
+    block_next(block)->size_flags &= ~BLOCK_PREV_USED;
+    bin_insert(block);
+}
+
+#ifdef HEAP_PROFILE
+/* Allocation profiler
+ *
+ * Each live allocation has a record (block, call site, tag, size, rdtsc
+ * timestamp) in an open-addressed table keyed by block address. Call sites
+ * and tags keep live and peak byte counts, so heap_profile_dump() can name
+ * whoever holds the heap without walking it.
+ */
+
+#define HEAP_PROFILE_RECORDS 4096 // Live allocations tracked (power of two)
+#define HEAP_PROFILE_SITES 256    // Distinct call sites (power of two)
+#define HEAP_PROFILE_TAGS 16
+
+typedef struct
+{
+    heap_block_t *block; // NULL: empty slot
+    uint64_t timestamp;  // rdtsc at allocation
+    uint32_t size;
+    uint32_t site; // Index into heap_profile_sites (which holds the tag)
+} heap_profile_record_t;
+
+typedef struct
+{
+    void *caller; // Return address of the kmalloc call (NULL: empty slot)
+    uint16_t tag;
+    uint32_t allocations;
+    uint32_t live_allocations;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+} heap_profile_site_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t allocations;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+} heap_profile_tag_t;
+
+static heap_profile_record_t heap_profile_records[HEAP_PROFILE_RECORDS];
+static heap_profile_site_t heap_profile_sites[HEAP_PROFILE_SITES];
+static heap_profile_tag_t heap_profile_tags[HEAP_PROFILE_TAGS];
+static uint32_t heap_profile_tag_count;
+static uint32_t heap_profile_histogram[HEAP_BINS]; // Allocations by floor(log2(size))
+static uint32_t heap_profile_peak_bytes;
+static uint32_t heap_profile_untracked; // Allocations that found the tables full
+
+static inline uint32_t heap_profile_hash(const void *key, uint32_t slots)
+{
+    return (((uint32_t)key >> 3) * 2654435761u) & (slots - 1);
+}
+
+static uint16_t heap_profile_tag_index(const char *tag)
+{
+    for (uint32_t i = 0; i < heap_profile_tag_count; i++)
+    {
+        if (heap_profile_tags[i].name == tag || strcmp(heap_profile_tags[i].name, tag) == 0)
+            return i;
+    }
+
+    // Out of tags: the last one collects everything else
+    if (heap_profile_tag_count == HEAP_PROFILE_TAGS)
+        return HEAP_PROFILE_TAGS - 1;
+
+    uint32_t index = heap_profile_tag_count++;
+    heap_profile_tags[index].name = index == HEAP_PROFILE_TAGS - 1 ? "other" : tag;
+    return index;
+}
+
+static void heap_profile_record(void *ptr, const char *tag, void *caller)
+{
+    if (!ptr)
+        return;
+
+    heap_block_t *block = (heap_block_t *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
+    uint32_t size = block->requested;
+
+    heap_profile_histogram[bin_index(size ? size : 1)]++;
+    if (heap_live_bytes > heap_profile_peak_bytes)
+        heap_profile_peak_bytes = heap_live_bytes;
+
+    // Find the call site and a free record slot; give up if either table is full
+    uint32_t site = heap_profile_hash(caller, HEAP_PROFILE_SITES);
+    uint32_t probes = 0;
+    while (heap_profile_sites[site].caller && heap_profile_sites[site].caller != caller)
+    {
+        if (++probes == HEAP_PROFILE_SITES)
+        {
+            heap_profile_untracked++;
+            return;
+        }
+        site = (site + 1) & (HEAP_PROFILE_SITES - 1);
+    }
+
+    uint32_t slot = heap_profile_hash(block, HEAP_PROFILE_RECORDS);
+    probes = 0;
+    while (heap_profile_records[slot].block)
+    {
+        if (++probes == HEAP_PROFILE_RECORDS)
+        {
+            heap_profile_untracked++;
+            return;
+        }
+        slot = (slot + 1) & (HEAP_PROFILE_RECORDS - 1);
+    }
+
+    heap_profile_site_t *s = &heap_profile_sites[site];
+    if (!s->caller)
+    {
+        s->caller = caller;
+        s->tag = heap_profile_tag_index(tag);
+    }
+    s->allocations++;
+    s->live_allocations++;
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+
+    heap_profile_tag_t *t = &heap_profile_tags[s->tag];
+    t->allocations++;
+    t->live_bytes += size;
+    if (t->live_bytes > t->peak_bytes)
+        t->peak_bytes = t->live_bytes;
+
+    heap_profile_records[slot].block = block;
+    heap_profile_records[slot].timestamp = rdtsc();
+    heap_profile_records[slot].size = size;
+    heap_profile_records[slot].site = site;
+}
+
+static void heap_profile_forget(heap_block_t *block)
+{
+    const uint32_t mask = HEAP_PROFILE_RECORDS - 1;
+    uint32_t slot = heap_profile_hash(block, HEAP_PROFILE_RECORDS);
+    uint32_t probes = 0;
+
+    while (heap_profile_records[slot].block != block)
+    {
+        if (!heap_profile_records[slot].block || ++probes == HEAP_PROFILE_RECORDS)
+            return; // Allocated before the tables had room
+        slot = (slot + 1) & mask;
+    }
 
-    // Move pointer past header
-    void *user_ptr = (char *)ptr + sizeof(size_t);
-    heap_current += total_size;
+    heap_profile_record_t *record = &heap_profile_records[slot];
+    heap_profile_site_t *site = &heap_profile_sites[record->site];
+    site->live_bytes -= record->size;
+    site->live_allocations--;
+    heap_profile_tags[site->tag].live_bytes -= record->size;
+
+    // Backward-shift deletion: pull later members of the probe run into the gap
+    uint32_t gap = slot;
+    for (uint32_t next = (slot + 1) & mask; heap_profile_records[next].block; next = (next + 1) & mask)
+    {
+        uint32_t home = heap_profile_hash(heap_profile_records[next].block, HEAP_PROFILE_RECORDS);
+        if (((next - home) & mask) >= ((next - gap) & mask))
+        {
+            heap_profile_records[gap] = heap_profile_records[next];
+            gap = next;
+        }
+    }
+    heap_profile_records[gap].block = NULL;
+}
+
+/**
+ * Age in cycles of the oldest live allocation from `site`
+ */
+static uint64_t heap_profile_oldest(uint32_t site, uint64_t now)
+{
+    uint64_t oldest = now;
+    for (uint32_t i = 0; i < HEAP_PROFILE_RECORDS; i++)
+    {
+        if (heap_profile_records[i].block && heap_profile_records[i].site == site &&
+            heap_profile_records[i].timestamp < oldest)
+        {
+            oldest = heap_profile_records[i].timestamp;
+        }
+    }
+    return now - oldest;
+}
+
+#define HEAP_PROFILE_RECORD(ptr, tag) heap_profile_record(ptr, tag, __builtin_return_address(0))
+#define HEAP_PROFILE_FORGET(block) heap_profile_forget(block)
+#else
+#define HEAP_PROFILE_RECORD(ptr, tag) ((void)0)
+#define HEAP_PROFILE_FORGET(block) ((void)0)
+#endif
+
+/**
+ * Add [start, start + size) to the heap as a free block followed by a fence
+ */
+static void heap_add_segment(uint8_t *start, uint32_t size)
+{
+    // A used, zero-sized fence at the end stops merges running off the segment
+    heap_block_t *fence = (heap_block_t *)(start + size - HEAP_HEADER_SIZE);
+    fence->size_flags = BLOCK_USED;
+    fence->requested = 0;
+
+    // The rest of the segment starts out as one free block
+    heap_block_t *block = (heap_block_t *)start;
+    block->size_flags = (size - HEAP_HEADER_SIZE) | BLOCK_PREV_USED;
+    block->requested = 0;
+    block_set_footer(block);
+    bin_insert(block);
+
+    if (!heap_start || start < heap_start)
+        heap_start = start;
+    if (start + size > heap_end)
+        heap_end = start + size;
+    heap_top = start + size;
+    heap_total_bytes += size;
+    heap_segments++;
+}
+
+/**
+ * Make room for a block of `need` bytes. Returns false if physical memory
+ * is exhausted.
+ */
+static bool heap_grow(uint32_t need)
+{
+    uint32_t size = (need + HEAP_HEADER_SIZE + HEAP_GROW_MIN - 1) & ~(HEAP_GROW_MIN - 1);
+
+    // Extend the newest segment in place: its fence becomes a free block
+    if (heap_top && pmm_claim_range((uint32_t)heap_top, (uint32_t)heap_top + size))
+    {
+        heap_block_t *block = (heap_block_t *)(heap_top - HEAP_HEADER_SIZE);
+        heap_block_t *fence = (heap_block_t *)(heap_top + size - HEAP_HEADER_SIZE);
+
+        fence->size_flags = BLOCK_USED;
+        fence->requested = 0;
+        block->size_flags = size | BLOCK_USED | (block->size_flags & BLOCK_PREV_USED);
+        heap_release_block(block); // Merges with a free block before the old fence
+
+        heap_top += size;
+        if (heap_top > heap_end)
+            heap_end = heap_top;
+        heap_total_bytes += size;
+        return true;
+    }
+
+    uint32_t order = 0;
+    while (((uint32_t)PAGE_SIZE << order) < size)
+    {
+        order++;
+    }
+    if (order > PMM_MAX_ORDER)
+        return false;
+
+    uint32_t segment = pmm_alloc_pages(order);
+    if (!segment)
+        return false;
+
+    heap_add_segment((uint8_t *)segment, PAGE_SIZE << order);
+    return true;
+}
+
+void memory_init(void)
+{
+    for (int i = 0; i < HEAP_BINS; i++)
+    {
+        heap_bins[i] = NULL;
+    }
+    for (int i = 0; i < HEAP_SMALL_CLASSES; i++)
+    {
+        heap_small_lists[i] = NULL;
+    }
+    heap_bin_bitmap = 0;
+    heap_live_bytes = 0;
+    heap_live_allocations = 0;
+    heap_free_bytes = 0;
+    heap_cached_bytes = 0;
+    heap_zeroed_bytes = 0;
+    heap_unzeroed_blocks = 0;
+    heap_start = NULL;
+    heap_end = NULL;
+    heap_top = NULL;
+    heap_total_bytes = 0;
+    heap_segments = 0;
+
+    // First segment right after the kernel image and the frame metadata
+    uint32_t start = pmm_metadata_end();
+    if (pmm_claim_range(start, start + HEAP_INITIAL_SIZE))
+    {
+        heap_add_segment((uint8_t *)start, HEAP_INITIAL_SIZE);
+    }
+    else
+    {
+        heap_grow(HEAP_INITIAL_SIZE - HEAP_HEADER_SIZE);
+    }
+}
+
+/**
+ * Allocate `size` bytes, clearing them if `zero` is set
+ */
+static void *heap_alloc(size_t size, bool zero)
+{
+    heap_block_t *block;
+    bool prezeroed = false;
+
+    if (size > HEAP_MAX_REQUEST)
+        return NULL;
+
+    if (size <= HEAP_SMALL_MAX)
+    {
+        uint32_t cls = small_class(size);
+        block = heap_small_lists[cls];
+
+        if (block)
+        {
+            heap_small_lists[cls] = block->next_free;
+            heap_cached_bytes -= block_size(block);
+        }
+        else
+        {
+            uint32_t need = HEAP_HEADER_SIZE + (1u << (cls + HEAP_SMALL_SHIFT));
+            block = heap_take_block(need);
+            if (!block && heap_grow(need))
+                block = heap_take_block(need);
+            if (!block)
+                return NULL;
+            block->size_flags |= BLOCK_SMALL;
+            prezeroed = block->requested == HEAP_BLOCK_ZEROED;
+        }
+    }
+    else
+    {
+        uint32_t need = (size + HEAP_HEADER_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+        block = heap_take_block(need);
+        if (!block && heap_grow(need))
+            block = heap_take_block(need);
+        if (!block)
+            return NULL; // Out of memory
+        prezeroed = block->requested == HEAP_BLOCK_ZEROED;
+    }
+
+    block->requested = size;
+    heap_live_bytes += size;
+    heap_live_allocations++;
+
+    void *user_ptr = (uint8_t *)block + HEAP_HEADER_SIZE;
 
     // Clear the allocated memory to prevent garbage data issues
-    for (size_t i = 0; i < size; i++)
+    if (zero && prezeroed)
     {
-        ((char *)user_ptr)[i] = 0;
+        // Only the old free-list links and footer are non-zero
+        uint32_t payload = block_size(block) - HEAP_HEADER_SIZE;
+        memzero(user_ptr, size < 8 ? size : 8);
+        if (payload - sizeof(uint32_t) < size)
+        {
+            memzero((uint8_t *)user_ptr + payload - sizeof(uint32_t), sizeof(uint32_t));
+        }
+    }
+    else if (zero)
+    {
+        memzero(user_ptr, size);
     }
 
     return user_ptr;
 }
 
-// Improved free function (still simple but safer)
+void *kmalloc(size_t size)
+{
+    void *ptr = heap_alloc(size, true);
+    HEAP_PROFILE_RECORD(ptr, "kernel");
+    return ptr;
+}
+
+/**
+ * Allocate without clearing, for callers that overwrite the whole block
+ */
+void *kmalloc_nozero(size_t size)
+{
+    void *ptr = heap_alloc(size, false);
+    HEAP_PROFILE_RECORD(ptr, "kernel");
+    return ptr;
+}
+
+#ifdef HEAP_PROFILE
+/**
+ * kmalloc() accounted to subsystem `tag` in the allocation profile
+ */
+void *kmalloc_tagged(size_t size, const char *tag)
+{
+    void *ptr = heap_alloc(size, true);
+    HEAP_PROFILE_RECORD(ptr, tag);
+    return ptr;
+}
+
+void *kmalloc_nozero_tagged(size_t size, const char *tag)
+{
+    void *ptr = heap_alloc(size, false);
+    HEAP_PROFILE_RECORD(ptr, tag);
+    return ptr;
+}
+#endif
+
 void kfree(void *ptr)
 {
     if (!ptr)
         return;
 
-    // For now, just mark as freed but don't actually reclaim
-    // In a full implementation, we'd maintain a free list
-    // This prevents crashes while allowing memory tracking
+    heap_block_t *block = (heap_block_t *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
 
-    // Get back to the header
-    void *header_ptr = (char *)ptr - sizeof(size_t);
-    size_t size = *((size_t *)header_ptr);
+    // Ignore pointers that are not live heap blocks (including double frees)
+    if ((uint8_t *)block < heap_start || (uint8_t *)block >= heap_end ||
+        !(block->size_flags & BLOCK_USED) || block->requested == HEAP_BLOCK_CACHED)
+    {
+        return;
+    }
 
+    HEAP_PROFILE_FORGET(block);
+    heap_live_bytes -= block->requested;
+    heap_live_allocations--;
+
+#ifndef KERNEL_RELEASE
     // Clear the memory to detect use-after-free bugs
-    for (size_t i = 0; i < size; i++)
+    memset(ptr, 0xDE, block->requested); // Dead beef pattern
+#endif
+
+    if (block->size_flags & BLOCK_SMALL)
+    {
+        // The class comes from the request: a block taken whole from a bin
+        // can be up to HEAP_MIN_BLOCK - 8 bytes bigger than its class
+        uint32_t cls = small_class(block->requested);
+        block->requested = HEAP_BLOCK_CACHED;
+        block->next_free = heap_small_lists[cls];
+        heap_small_lists[cls] = block;
+        heap_cached_bytes += block_size(block);
+        return;
+    }
+
+    heap_release_block(block);
+}
+
+/**
+ * Zero one free block for later allocations (called from the idle task).
+ * Returns false once there is nothing left worth zeroing.
+ */
+bool heap_prezero_step(void)
+{
+    if (!heap_unzeroed_blocks)
+        return false;
+
+    // Largest blocks first: they serve the allocations that cost most to clear
+    for (int idx = HEAP_BINS - 1; idx >= 0; idx--)
+    {
+        if (!(heap_bin_bitmap & (1u << idx)))
+            continue;
+
+        for (heap_block_t *block = heap_bins[idx]; block; block = block->next_free)
+        {
+            uint32_t size = block_size(block);
+            if (block->requested == HEAP_BLOCK_ZEROED || size < HEAP_PREZERO_MIN)
+                continue;
+
+            // Everything between the links and the footer
+            memzero((uint8_t *)block + sizeof(heap_block_t), size - sizeof(heap_block_t) - sizeof(uint32_t));
+            block->requested = HEAP_BLOCK_ZEROED;
+            heap_zeroed_bytes += size;
+            heap_unzeroed_blocks--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Snapshot heap usage for the `memory` command
+ */
+void heap_get_stats(heap_stats_t *stats)
+{
+    uint32_t largest = 0;
+
+    // Only the highest non-empty bin can hold the largest free block
+    if (heap_bin_bitmap)
+    {
+        uint32_t idx = 31 - __builtin_clz(heap_bin_bitmap);
+        for (heap_block_t *block = heap_bins[idx]; block; block = block->next_free)
+        {
+            if (block_size(block) > largest)
+                largest = block_size(block);
+        }
+    }
+
+    stats->heap_start = (uint32_t)heap_start;
+    stats->heap_size = heap_total_bytes;
+    stats->segments = heap_segments;
+    stats->live_bytes = heap_live_bytes;
+    stats->live_allocations = heap_live_allocations;
+    stats->free_bytes = heap_free_bytes + heap_cached_bytes;
+    stats->largest_free = largest;
+    stats->fragmented_bytes = stats->free_bytes - largest;
+    stats->zeroed_bytes = heap_zeroed_bytes;
+}
+
+/**
+ * Write the allocation profile to the serial port: per-tag totals, the
+ * `top_sites` call sites holding the most live bytes, and a size histogram
+ */
+void heap_profile_dump(uint32_t top_sites)
+{
+#ifdef HEAP_PROFILE
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+
+    uint32_t fragmentation = stats.free_bytes ? (uint32_t)((uint64_t)stats.fragmented_bytes * 100 / stats.free_bytes) : 0;
+
+    serial_write_string("heap profile: ");
+    serial_write_dec(stats.live_bytes);
+    serial_write_string(" live bytes in ");
+    serial_write_dec(stats.live_allocations);
+    serial_write_string(" allocations, peak ");
+    serial_write_dec(heap_profile_peak_bytes);
+    serial_write_string(", heap ");
+    serial_write_dec(stats.heap_size);
+    serial_write_string(", fragmentation ");
+    serial_write_dec(fragmentation);
+    serial_write_string("%, untracked ");
+    serial_write_dec(heap_profile_untracked);
+    serial_write_string("\n");
+
+    serial_write_string("by tag (live / peak / allocations):\n");
+    for (uint32_t i = 0; i < heap_profile_tag_count; i++)
+    {
+        serial_write_string("  ");
+        serial_write_string(heap_profile_tags[i].name);
+        serial_write_string(": ");
+        serial_write_dec(heap_profile_tags[i].live_bytes);
+        serial_write_string(" / ");
+        serial_write_dec(heap_profile_tags[i].peak_bytes);
+        serial_write_string(" / ");
+        serial_write_dec(heap_profile_tags[i].allocations);
+        serial_write_string("\n");
+    }
+
+    serial_write_string("top call sites by live bytes:\n");
+    uint8_t shown[HEAP_PROFILE_SITES] = {0};
+    uint64_t now = rdtsc();
+    for (uint32_t rank = 0; rank < top_sites; rank++)
+    {
+        int best = -1;
+        for (uint32_t i = 0; i < HEAP_PROFILE_SITES; i++)
+        {
+            if (heap_profile_sites[i].caller && !shown[i] &&
+                (best < 0 || heap_profile_sites[i].live_bytes > heap_profile_sites[best].live_bytes))
+            {
+                best = i;
+            }
+        }
+        if (best < 0)
+            break;
+        shown[best] = 1;
+
+        heap_profile_site_t *site = &heap_profile_sites[best];
+        serial_write_string("  ");
+        serial_write_hex((uint32_t)site->caller);
+        serial_write_string(" [");
+        serial_write_string(heap_profile_tags[site->tag].name);
+        serial_write_string("] live ");
+        serial_write_dec(site->live_bytes);
+        serial_write_string(" in ");
+        serial_write_dec(site->live_allocations);
+        serial_write_string(", peak ");
+        serial_write_dec(site->peak_bytes);
+        serial_write_string(", allocations ");
+        serial_write_dec(site->allocations);
+        if (site->live_allocations)
+        {
+            serial_write_string(", oldest ");
+            serial_write_dec((uint32_t)(heap_profile_oldest(best, now) / 1000000));
+            serial_write_string("M cycles");
+        }
+        serial_write_string("\n");
+    }
+
+    serial_write_string("allocation sizes:\n");
+    for (uint32_t i = 0; i < HEAP_BINS; i++)
     {
-        ((char *)ptr)[i] = 0xDE; // Dead beef pattern
+        if (!heap_profile_histogram[i])
+            continue;
+        serial_write_string("  ");
+        serial_write_dec(1u << i);
+        serial_write_string("+: ");
+        serial_write_dec(heap_profile_histogram[i]);
+        serial_write_string("\n");
     }
 
-    // TODO: Add to free list for reuse
+    vga_print("Heap profile written to serial (COM1)\n");
+#else
+    (void)top_sites;
+    vga_print("Heap profiling is off - build with 'make profile'\n");
+#endif
 }
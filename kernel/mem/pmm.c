@@ -0,0 +1,472 @@
+/* Physical Memory Manager - buddy allocator for 4KB frames
+ *
+ * Free memory is kept as power-of-two blocks of 2^order frames, one free
+ * list per order. Allocation splits a larger block down to the requested
+ * order; freeing merges a block with its buddy (the block whose index
+ * differs only in bit `order`) for as long as the buddy is free, so both
+ * are O(log n). Each frame has one byte of metadata: block heads record
+ * PMM_FRAME_FREE or PMM_FRAME_ALLOCATED plus their order; every other
+ * frame (reserved, or inside a block) is 0. Allocated single frames also
+ * carry a reference count so they can be shared between address spaces.
+ *
+ * The free lists are threaded through the free blocks themselves.
+ */
+
+#include "pmm.h"
+
+#define PMM_FRAME_FREE 0x80      // Head of a free block
+#define PMM_FRAME_ALLOCATED 0x40 // Head of an allocated block
+
+#define PMM_ZERO_POOL_SIZE 32 // Pre-zeroed frames kept by the idle task
+#define PMM_MAX_REGIONS 32    // Usable memory-map entries remembered at boot
+
+typedef struct pmm_block
+{
+    struct pmm_block *next;
+    struct pmm_block *prev;
+} pmm_block_t;
+
+// Usable RAM from the memory map, [start, end)
+typedef struct
+{
+    uint32_t start;
+    uint32_t end;
+} pmm_region_t;
+
+static uint8_t *frame_info = NULL; // One byte per frame
+static uint16_t *frame_refs = NULL; // References per allocated frame
+static uint32_t frame_count = 0;   // Frames covered by frame_info
+static pmm_block_t *free_lists[PMM_MAX_ORDER + 1];
+static uint32_t free_list_bitmap = 0; // Bit n set if free_lists[n] is non-empty
+static uint32_t free_frames = 0;
+static uint32_t managed_frames = 0;
+static uint32_t usable_memory = 0;
+static uint32_t metadata_end = 0; // First byte after kernel image and frame metadata
+
+// Frames zeroed ahead of time, handed out by pmm_alloc_zeroed_frame()
+static uint32_t zero_pool[PMM_ZERO_POOL_SIZE];
+static uint32_t zero_pool_count = 0;
+
+static inline pmm_block_t *frame_block(uint32_t frame)
+{
+    return (pmm_block_t *)(frame << PAGE_SHIFT);
+}
+
+static void free_list_push(uint32_t frame, uint32_t order)
+{
+    pmm_block_t *block = frame_block(frame);
+
+    block->prev = NULL;
+    block->next = free_lists[order];
+    if (free_lists[order])
+    {
+        free_lists[order]->prev = block;
+    }
+    free_lists[order] = block;
+
+    free_list_bitmap |= 1u << order;
+    frame_info[frame] = PMM_FRAME_FREE | order;
+    free_frames += 1u << order;
+}
+
+static void free_list_remove(uint32_t frame, uint32_t order)
+{
+    pmm_block_t *block = frame_block(frame);
+
+    if (block->prev)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        free_lists[order] = block->next;
+    }
+
+    if (block->next)
+    {
+        block->next->prev = block->prev;
+    }
+
+    if (!free_lists[order])
+    {
+        free_list_bitmap &= ~(1u << order);
+    }
+    frame_info[frame] = 0;
+    free_frames -= 1u << order;
+}
+
+/**
+ * Free a block, merging it with its buddy as far up as possible
+ */
+static void pmm_free_block(uint32_t frame, uint32_t order)
+{
+    while (order < PMM_MAX_ORDER)
+    {
+        uint32_t buddy = frame ^ (1u << order);
+        if (buddy + (1u << order) > frame_count || frame_info[buddy] != (PMM_FRAME_FREE | order))
+            break;
+
+        free_list_remove(buddy, order);
+        frame &= ~(1u << order);
+        order++;
+    }
+
+    free_list_push(frame, order);
+}
+
+/**
+ * Take one frame out of whatever free block contains it.
+ * Returns false if the frame is not free.
+ */
+static bool pmm_claim(uint32_t frame)
+{
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++)
+    {
+        uint32_t head = frame & ~((1u << order) - 1);
+        if (frame_info[head] != (PMM_FRAME_FREE | order))
+            continue;
+
+        // Split the block down, giving back the halves that do not hold the frame
+        free_list_remove(head, order);
+        while (order > 0)
+        {
+            order--;
+            uint32_t half = 1u << order;
+            if (frame & half)
+            {
+                free_list_push(head, order);
+                head += half;
+            }
+            else
+            {
+                free_list_push(head + half, order);
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Return every whole frame in [start, end) to the allocator
+ */
+static void pmm_add_range(uint32_t start, uint32_t end)
+{
+    uint32_t frame = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t last = end >> PAGE_SHIFT;
+
+    if (last > frame_count)
+        last = frame_count;
+
+    for (; frame < last; frame++)
+    {
+        managed_frames++;
+        pmm_free_block(frame, 0);
+    }
+}
+
+/**
+ * Initialize the allocator from the multiboot memory map
+ */
+void pmm_init(uint32_t magic, multiboot_info_t *mbi)
+{
+    uint32_t highest = 0;
+    bool have_map = (magic == MULTIBOOT_BOOTLOADER_MAGIC && mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP));
+
+    // The loader may have put the multiboot information right after the
+    // kernel, where the frame metadata is about to go: copy the usable
+    // regions out of the map before anything is written there
+    pmm_region_t regions[PMM_MAX_REGIONS];
+    uint32_t region_count = 0;
+
+    // Find the top of usable memory
+    if (have_map)
+    {
+        uint32_t addr = mbi->mmap_addr;
+        while (addr < mbi->mmap_addr + mbi->mmap_length)
+        {
+            multiboot_mmap_entry_t *entry = (multiboot_mmap_entry_t *)addr;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr < PMM_MAX_ADDRESS)
+            {
+                uint64_t top = entry->addr + entry->len;
+                if (top > PMM_MAX_ADDRESS)
+                    top = PMM_MAX_ADDRESS;
+
+                if (region_count < PMM_MAX_REGIONS)
+                {
+                    regions[region_count].start = (uint32_t)entry->addr;
+                    regions[region_count].end = (uint32_t)top;
+                    region_count++;
+
+                    if (top > highest)
+                        highest = (uint32_t)top;
+                    usable_memory += (uint32_t)(top - entry->addr);
+                }
+            }
+            addr += entry->size + sizeof(entry->size);
+        }
+    }
+    else if (magic == MULTIBOOT_BOOTLOADER_MAGIC && mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY))
+    {
+        highest = 0x100000 + mbi->mem_upper * 1024;
+        if (highest > PMM_MAX_ADDRESS)
+            highest = PMM_MAX_ADDRESS;
+        usable_memory = highest - 0x100000;
+    }
+    else
+    {
+        vga_print("  PMM: no memory map, assuming 16MB\n");
+        highest = PMM_FALLBACK_MEMORY;
+        usable_memory = highest - 0x100000;
+    }
+
+    // Frame metadata goes right after the kernel image
+    frame_count = highest >> PAGE_SHIFT;
+    frame_info = (uint8_t *)(((uint32_t)kernel_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    memset(frame_info, 0, frame_count);
+    frame_refs = (uint16_t *)(((uint32_t)frame_info + frame_count + 1) & ~1u);
+    memset(frame_refs, 0, frame_count * sizeof(uint16_t));
+
+    uint32_t reserved_end = ((uint32_t)(frame_refs + frame_count) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    metadata_end = reserved_end;
+
+    for (int i = 0; i <= PMM_MAX_ORDER; i++)
+    {
+        free_lists[i] = NULL;
+    }
+    free_list_bitmap = 0;
+    free_frames = 0;
+    managed_frames = 0;
+
+    // Everything below the metadata (BIOS area, kernel image, metadata) stays reserved
+    if (have_map)
+    {
+        for (uint32_t i = 0; i < region_count; i++)
+        {
+            uint32_t start = regions[i].start;
+            if (start < reserved_end)
+                start = reserved_end;
+            if (start < regions[i].end)
+                pmm_add_range(start, regions[i].end);
+        }
+    }
+    else
+    {
+        pmm_add_range(reserved_end, highest);
+    }
+
+    vga_print("  PMM: ");
+    vga_print_dec(free_frames);
+    vga_print(" free frames (");
+    vga_print_dec(free_frames / 256);
+    vga_print("MB)\n");
+}
+
+/**
+ * Allocate 2^order physically contiguous frames.
+ * Returns the physical address, or 0 if no block is large enough.
+ */
+uint32_t pmm_alloc_pages(uint32_t order)
+{
+    if (order > PMM_MAX_ORDER)
+        return 0;
+
+    // Smallest non-empty list at or above the requested order
+    uint32_t candidates = free_list_bitmap & ~((1u << order) - 1);
+    if (!candidates)
+        return 0; // Out of memory
+
+    uint32_t current = __builtin_ctz(candidates);
+    uint32_t frame = (uint32_t)free_lists[current] >> PAGE_SHIFT;
+    free_list_remove(frame, current);
+
+    // Split down, returning the upper halves to their free lists
+    while (current > order)
+    {
+        current--;
+        free_list_push(frame + (1u << current), current);
+    }
+
+    frame_info[frame] = PMM_FRAME_ALLOCATED | order;
+    frame_refs[frame] = 1;
+    return frame << PAGE_SHIFT;
+}
+
+/**
+ * Free a block previously returned by pmm_alloc_pages with the same order
+ */
+void pmm_free_pages(uint32_t addr, uint32_t order)
+{
+    uint32_t frame = addr >> PAGE_SHIFT;
+
+    if (!addr || (addr & (PAGE_SIZE - 1)) || order > PMM_MAX_ORDER || frame >= frame_count)
+        return;
+
+    if (frame_info[frame] != (PMM_FRAME_ALLOCATED | order))
+        return; // Not an allocated block of this order (or a double free)
+
+    frame_info[frame] = 0;
+    frame_refs[frame] = 0;
+    pmm_free_block(frame, order);
+}
+
+uint32_t pmm_alloc_frame(void)
+{
+    return pmm_alloc_pages(0);
+}
+
+void pmm_free_frame(uint32_t addr)
+{
+    pmm_free_pages(addr, 0);
+}
+
+/**
+ * Allocate a zeroed frame, from the pre-zeroed pool when possible
+ */
+uint32_t pmm_alloc_zeroed_frame(void)
+{
+    if (zero_pool_count > 0)
+        return zero_pool[--zero_pool_count];
+
+    uint32_t frame = pmm_alloc_frame();
+    if (frame)
+    {
+        memzero((void *)frame, PAGE_SIZE);
+    }
+    return frame;
+}
+
+/**
+ * Zero one more frame into the pool (called from the idle task).
+ * Returns false once the pool is full or memory is short.
+ */
+bool pmm_prezero_step(void)
+{
+    // Keep the pool from eating the last free memory
+    if (zero_pool_count >= PMM_ZERO_POOL_SIZE || free_frames <= PMM_ZERO_POOL_SIZE)
+        return false;
+
+    uint32_t frame = pmm_alloc_frame();
+    if (!frame)
+        return false;
+
+    memzero((void *)frame, PAGE_SIZE);
+    zero_pool[zero_pool_count++] = frame;
+    return true;
+}
+
+/**
+ * Take another reference to an allocated frame (e.g. a shared mapping)
+ */
+void pmm_frame_get(uint32_t addr)
+{
+    uint32_t frame = addr >> PAGE_SHIFT;
+
+    if (frame < frame_count && frame_refs[frame])
+    {
+        frame_refs[frame]++;
+    }
+}
+
+/**
+ * Drop a reference to a frame, freeing it with the last one
+ */
+void pmm_frame_put(uint32_t addr)
+{
+    uint32_t frame = addr >> PAGE_SHIFT;
+
+    if (frame >= frame_count || !frame_refs[frame])
+        return;
+
+    if (--frame_refs[frame] == 0)
+    {
+        pmm_free_pages(addr & ~(PAGE_SIZE - 1), 0);
+    }
+}
+
+uint32_t pmm_frame_refcount(uint32_t addr)
+{
+    uint32_t frame = addr >> PAGE_SHIFT;
+    return frame < frame_count ? frame_refs[frame] : 0;
+}
+
+/**
+ * End of the kernel image plus the frame metadata placed after it
+ */
+uint32_t pmm_metadata_end(void)
+{
+    return metadata_end;
+}
+
+static bool pmm_frame_is_free(uint32_t frame)
+{
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++)
+    {
+        if (frame_info[frame & ~((1u << order) - 1)] == (PMM_FRAME_FREE | order))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Hand the frames in [start, end) to the caller, but only if all of them
+ * are free. Returns false, claiming nothing, otherwise.
+ */
+bool pmm_claim_range(uint32_t start, uint32_t end)
+{
+    uint32_t first = start >> PAGE_SHIFT;
+    uint32_t last = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+    if (last > frame_count)
+        return false;
+
+    for (uint32_t frame = first; frame < last; frame++)
+    {
+        if (!pmm_frame_is_free(frame))
+            return false;
+    }
+
+    for (uint32_t frame = first; frame < last; frame++)
+    {
+        pmm_claim(frame);
+    }
+    return true;
+}
+
+/**
+ * Keep the allocator away from [start, end) (for memory owned by someone else)
+ */
+void pmm_reserve_range(uint32_t start, uint32_t end)
+{
+    uint32_t last = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+    if (last > frame_count)
+        last = frame_count;
+
+    for (uint32_t frame = start >> PAGE_SHIFT; frame < last; frame++)
+    {
+        if (pmm_claim(frame))
+        {
+            managed_frames--;
+        }
+    }
+}
+
+void pmm_get_stats(pmm_stats_t *stats)
+{
+    stats->total_memory = usable_memory;
+    stats->total_frames = managed_frames;
+    stats->free_frames = free_frames;
+    stats->zeroed_frames = zero_pool_count;
+
+    for (int order = 0; order <= PMM_MAX_ORDER; order++)
+    {
+        uint32_t count = 0;
+        for (pmm_block_t *block = free_lists[order]; block; block = block->next)
+        {
+            count++;
+        }
+        stats->free_blocks[order] = count;
+    }
+}
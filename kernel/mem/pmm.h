@@ -0,0 +1,44 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "../kernel.h"
+#include "../multiboot.h"
+
+// Physical memory manager configuration
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define PMM_MAX_ORDER 10              // Largest block is 4KB << 10 = 4MB
+#define PMM_MAX_ADDRESS 0x40000000    // Only the low 1GB is managed
+#define PMM_FALLBACK_MEMORY 0x1000000 // Assumed RAM when the loader gives no map
+
+// Physical memory statistics
+typedef struct
+{
+    uint32_t total_memory; // Bytes of usable RAM reported by the loader
+    uint32_t total_frames; // Frames managed by the allocator
+    uint32_t free_frames;  // Frames currently free
+    uint32_t zeroed_frames; // Frames waiting pre-zeroed in the pool
+    uint32_t free_blocks[PMM_MAX_ORDER + 1]; // Free blocks per order
+} pmm_stats_t;
+
+// Linker-provided bounds of the kernel image
+extern uint8_t kernel_start[];
+extern uint8_t kernel_end[];
+
+// Physical memory manager
+void pmm_init(uint32_t magic, multiboot_info_t *mbi);
+uint32_t pmm_alloc_pages(uint32_t order);
+void pmm_free_pages(uint32_t addr, uint32_t order);
+uint32_t pmm_alloc_frame(void);
+void pmm_free_frame(uint32_t addr);
+uint32_t pmm_alloc_zeroed_frame(void);
+bool pmm_prezero_step(void);
+void pmm_frame_get(uint32_t addr);
+void pmm_frame_put(uint32_t addr);
+uint32_t pmm_frame_refcount(uint32_t addr);
+bool pmm_claim_range(uint32_t start, uint32_t end);
+void pmm_reserve_range(uint32_t start, uint32_t end);
+uint32_t pmm_metadata_end(void);
+void pmm_get_stats(pmm_stats_t *stats);
+
+#endif
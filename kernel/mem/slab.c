@@ -0,0 +1,275 @@
+/* Slab Allocator - object caches for fixed-size kernel objects
+ *
+ * A cache hands out objects of one size from page-sized slabs. Objects are
+ * constructed once when their slab is created and are returned to the cache
+ * in that constructed state, so alloc and free are both a free-list pop/push.
+ * The slab header lives at the start of its page, which lets slab_free()
+ * find it by masking the object address.
+ */
+
+#include "slab.h"
+#include "pmm.h"
+
+// Pages handed out before the frame allocator is up (or when it runs dry)
+#define SLAB_BOOT_PAGES 32
+
+static slab_cache_t slab_caches[SLAB_MAX_CACHES];
+static uint32_t slab_cache_count = 0;
+
+static uint8_t slab_boot_pages[SLAB_BOOT_PAGES][SLAB_SIZE] __attribute__((aligned(SLAB_SIZE)));
+static uint32_t slab_boot_next = 0;
+static void *slab_free_pages = NULL; // Pages released by empty slabs
+
+static void *slab_page_alloc(void)
+{
+    if (slab_free_pages)
+    {
+        void *page = slab_free_pages;
+        slab_free_pages = *(void **)page;
+        return page;
+    }
+
+    uint32_t frame = pmm_alloc_frame();
+    if (frame)
+    {
+        return (void *)frame;
+    }
+
+    if (slab_boot_next < SLAB_BOOT_PAGES)
+    {
+        return slab_boot_pages[slab_boot_next++];
+    }
+
+    return NULL; // Out of slab pages
+}
+
+static void slab_page_free(void *page)
+{
+    // Boot pages stay with the slab layer; frames go back to the frame allocator
+    if ((uint32_t)page - (uint32_t)slab_boot_pages < sizeof(slab_boot_pages))
+    {
+        *(void **)page = slab_free_pages;
+        slab_free_pages = page;
+    }
+    else
+    {
+        pmm_free_frame((uint32_t)page);
+    }
+}
+
+static inline void **slab_link(slab_cache_t *cache, void *object)
+{
+    return (void **)((uint8_t *)object + cache->link_offset);
+}
+
+static void slab_list_add(slab_t **list, slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list)
+    {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_list_remove(slab_t **list, slab_t *slab)
+{
+    if (slab->prev)
+    {
+        slab->prev->next = slab->next;
+    }
+    else
+    {
+        *list = slab->next;
+    }
+
+    if (slab->next)
+    {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+/**
+ * Create a cache for objects of `size` bytes aligned to `align`
+ */
+slab_cache_t *slab_cache_create(const char *name, uint32_t size, uint32_t align, slab_ctor_t ctor)
+{
+    if (slab_cache_count >= SLAB_MAX_CACHES || size == 0)
+        return NULL;
+
+    if (align < sizeof(void *))
+        align = sizeof(void *);
+
+    // The free-list link sits just past the object so constructed state survives
+    uint32_t link_offset = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    uint32_t stride = (link_offset + sizeof(void *) + align - 1) & ~(align - 1);
+    uint32_t first_offset = (sizeof(slab_t) + align - 1) & ~(align - 1);
+
+    if (first_offset + stride > SLAB_SIZE)
+        return NULL; // Object does not fit in a slab
+
+    slab_cache_t *cache = &slab_caches[slab_cache_count++];
+    cache->name = name;
+    cache->object_size = size;
+    cache->stride = stride;
+    cache->first_offset = first_offset;
+    cache->link_offset = link_offset;
+    cache->objects_per_slab = (SLAB_SIZE - first_offset) / stride;
+    cache->ctor = ctor;
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->slab_count = 0;
+    cache->active_objects = 0;
+    cache->total_objects = 0;
+    cache->alloc_count = 0;
+    cache->free_count = 0;
+
+    return cache;
+}
+
+/**
+ * Add a new slab of constructed objects to the cache's empty list
+ */
+static slab_t *slab_grow(slab_cache_t *cache)
+{
+    slab_t *slab = (slab_t *)slab_page_alloc();
+    if (!slab)
+        return NULL;
+
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free_list = NULL;
+
+    // Build the free list back to front so objects are handed out in address order
+    uint8_t *base = (uint8_t *)slab + cache->first_offset;
+    for (uint32_t i = cache->objects_per_slab; i > 0; i--)
+    {
+        void *object = base + (i - 1) * cache->stride;
+        if (cache->ctor)
+        {
+            cache->ctor(object);
+        }
+        *slab_link(cache, object) = slab->free_list;
+        slab->free_list = object;
+    }
+
+    slab_list_add(&cache->empty, slab);
+    cache->slab_count++;
+    cache->total_objects += cache->objects_per_slab;
+
+    return slab;
+}
+
+/**
+ * Allocate a constructed object from the cache
+ */
+void *slab_alloc(slab_cache_t *cache)
+{
+    if (!cache)
+        return NULL;
+
+    slab_t *slab = cache->partial;
+    if (!slab)
+    {
+        slab = cache->empty ? cache->empty : slab_grow(cache);
+        if (!slab)
+            return NULL; // Out of memory
+
+        slab_list_remove(&cache->empty, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    void *object = slab->free_list;
+    slab->free_list = *slab_link(cache, object);
+    slab->in_use++;
+
+    if (!slab->free_list)
+    {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->active_objects++;
+    cache->alloc_count++;
+
+    return object;
+}
+
+/**
+ * Return an object (in its constructed state) to its cache
+ */
+void slab_free(slab_cache_t *cache, void *object)
+{
+    if (!cache || !object)
+        return;
+
+    slab_t *slab = (slab_t *)((uint32_t)object & ~(SLAB_SIZE - 1));
+    if (slab->cache != cache)
+        return; // Object does not belong to this cache
+
+    if (slab->in_use == cache->objects_per_slab)
+    {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    *slab_link(cache, object) = slab->free_list;
+    slab->free_list = object;
+    slab->in_use--;
+
+    cache->active_objects--;
+    cache->free_count++;
+
+    if (slab->in_use == 0)
+    {
+        slab_list_remove(&cache->partial, slab);
+
+        // Keep one empty slab around so alloc/free at a boundary does not thrash
+        if (cache->empty)
+        {
+            cache->slab_count--;
+            cache->total_objects -= cache->objects_per_slab;
+            slab_page_free(slab);
+        }
+        else
+        {
+            slab_list_add(&cache->empty, slab);
+        }
+    }
+}
+
+/**
+ * Print per-cache statistics
+ */
+void slab_print_stats(void)
+{
+    vga_print("CACHE\t\tSIZE\tACTIVE\tTOTAL\tSLABS\tALLOCS\n");
+
+    for (uint32_t i = 0; i < slab_cache_count; i++)
+    {
+        slab_cache_t *cache = &slab_caches[i];
+
+        vga_print(cache->name);
+        vga_print("\t");
+        vga_print_dec(cache->object_size);
+        vga_print("\t");
+        vga_print_dec(cache->active_objects);
+        vga_print("\t");
+        vga_print_dec(cache->total_objects);
+        vga_print("\t");
+        vga_print_dec(cache->slab_count);
+        vga_print("\t");
+        vga_print_dec(cache->alloc_count);
+        vga_print("\n");
+    }
+
+    if (slab_cache_count == 0)
+    {
+        vga_print("(No caches)\n");
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "../kernel.h"
+
+// Slab configuration
+#define SLAB_SIZE 4096     // Each slab is one page
+#define CACHE_LINE_SIZE 64 // Default object alignment
+#define SLAB_MAX_CACHES 16
+
+// Object constructor, run once when a slab is created
+typedef void (*slab_ctor_t)(void *object);
+
+// One page of objects; this header sits at the start of the page
+typedef struct slab
+{
+    struct slab *next;        // Next slab in the cache list
+    struct slab *prev;        // Previous slab in the cache list
+    struct slab_cache *cache; // Owning cache
+    void *free_list;          // Free objects in this slab
+    uint32_t in_use;          // Objects currently allocated
+} slab_t;
+
+// A cache of equally sized objects
+typedef struct slab_cache
+{
+    const char *name;
+    uint32_t object_size;      // Size requested by the cache owner
+    uint32_t stride;           // Distance between objects (aligned)
+    uint32_t first_offset;     // Offset of the first object in a slab
+    uint32_t link_offset;      // Offset of the free-list link inside an object
+    uint32_t objects_per_slab; // Objects that fit in one slab
+    slab_ctor_t ctor;          // Constructor (may be NULL)
+
+    slab_t *partial; // Slabs with free and used objects
+    slab_t *full;    // Slabs with no free objects
+    slab_t *empty;   // Slabs with no used objects (at most one is kept)
+
+    // Statistics
+    uint32_t slab_count;     // Slabs owned by the cache
+    uint32_t active_objects; // Objects currently allocated
+    uint32_t total_objects;  // Objects across all slabs
+    uint32_t alloc_count;    // Lifetime allocations
+    uint32_t free_count;     // Lifetime frees
+} slab_cache_t;
+
+// Slab cache API
+slab_cache_t *slab_cache_create(const char *name, uint32_t size, uint32_t align, slab_ctor_t ctor);
+void *slab_alloc(slab_cache_t *cache);
+void slab_free(slab_cache_t *cache, void *object);
+void slab_print_stats(void);
+
+#endif
@@ -0,0 +1,212 @@
+/* Stack Pool - recycled page-aligned stacks
+ *
+ * Stacks released by dead processes are parked on a per-pool idle list,
+ * up to the pool's high-water mark, and handed straight to the next
+ * process: no frame allocator traffic and no zeroing. The idle list is
+ * threaded through the lowest word of each idle stack.
+ *
+ * Kernel space is mapped with 4MB pages, so a guard page cannot be left
+ * unmapped there. Instead the page below a guarded stack is filled with
+ * STACK_GUARD_PATTERN and checked whenever the stack comes back.
+ */
+
+#include "stack_pool.h"
+#include "pmm.h"
+
+static stack_pool_t stack_pools[STACK_POOL_MAX_POOLS];
+static uint32_t stack_pool_count = 0;
+
+static inline uint32_t stack_block_base(stack_pool_t *pool, uint32_t base)
+{
+    return pool->guard ? base - PAGE_SIZE : base;
+}
+
+static void stack_guard_fill(uint32_t guard)
+{
+    uint32_t *word = (uint32_t *)guard;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++)
+    {
+        word[i] = STACK_GUARD_PATTERN;
+    }
+}
+
+/**
+ * Check the guard page below a returned stack, repairing it if it was hit
+ */
+static void stack_guard_check(stack_pool_t *pool, uint32_t guard)
+{
+    uint32_t *word = (uint32_t *)guard;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++)
+    {
+        if (word[i] != STACK_GUARD_PATTERN)
+        {
+            pool->guard_failures++;
+            vga_print("Stack pool ");
+            vga_print(pool->name);
+            vga_print(": overflow into guard page at ");
+            vga_print_hex(guard);
+            vga_print("\n");
+            stack_guard_fill(guard);
+            return;
+        }
+    }
+}
+
+/**
+ * Create a pool of `stack_size` stacks (rounded up to whole pages), with a
+ * guard page below each one if `guard` is set. Returns NULL when all pool
+ * slots are taken.
+ */
+stack_pool_t *stack_pool_create(const char *name, uint32_t stack_size, bool guard, uint32_t high_water)
+{
+    if (stack_pool_count >= STACK_POOL_MAX_POOLS)
+        return NULL;
+
+    stack_pool_t *pool = &stack_pools[stack_pool_count++];
+    uint32_t pages = (stack_size + PAGE_SIZE - 1) / PAGE_SIZE + (guard ? 1 : 0);
+
+    pool->name = name;
+    pool->guard = guard;
+    pool->high_water = high_water;
+    pool->order = 0;
+    while ((1u << pool->order) < pages)
+    {
+        pool->order++;
+    }
+
+    // Pages left over by rounding the block up to a power of two add to the
+    // stack, so the guard still sits directly below the usable area
+    pool->stack_size = (PAGE_SIZE << pool->order) - (guard ? PAGE_SIZE : 0);
+
+    pool->idle_list = NULL;
+    pool->idle = 0;
+    pool->in_use = 0;
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->guard_failures = 0;
+    return pool;
+}
+
+/**
+ * Take a stack from the pool. Returns its base (lowest usable address),
+ * or 0 if the frame allocator is out of memory. Contents are not cleared.
+ */
+uint32_t stack_pool_get(stack_pool_t *pool)
+{
+    uint32_t base;
+
+    if (pool->idle_list)
+    {
+        base = (uint32_t)pool->idle_list;
+        pool->idle_list = *(void **)pool->idle_list;
+        pool->idle--;
+        pool->hits++;
+    }
+    else
+    {
+        uint32_t block = pmm_alloc_pages(pool->order);
+        if (!block)
+            return 0;
+
+        base = block + (pool->guard ? PAGE_SIZE : 0);
+        if (pool->guard)
+        {
+            stack_guard_fill(block);
+        }
+        pool->misses++;
+    }
+
+    pool->in_use++;
+    return base;
+}
+
+/**
+ * Return a stack to the pool, or to the frame allocator above the high-water mark
+ */
+void stack_pool_put(stack_pool_t *pool, uint32_t base)
+{
+    if (!base)
+        return;
+
+    if (pool->guard)
+    {
+        stack_guard_check(pool, base - PAGE_SIZE);
+    }
+
+    pool->in_use--;
+
+    if (pool->idle >= pool->high_water)
+    {
+        pmm_free_pages(stack_block_base(pool, base), pool->order);
+        return;
+    }
+
+    *(void **)base = pool->idle_list;
+    pool->idle_list = (void *)base;
+    pool->idle++;
+}
+
+/**
+ * Change how many idle stacks the pool keeps, releasing any excess now
+ */
+void stack_pool_set_high_water(stack_pool_t *pool, uint32_t high_water)
+{
+    pool->high_water = high_water;
+
+    while (pool->idle > high_water)
+    {
+        uint32_t base = (uint32_t)pool->idle_list;
+        pool->idle_list = *(void **)pool->idle_list;
+        pool->idle--;
+        pmm_free_pages(stack_block_base(pool, base), pool->order);
+    }
+}
+
+void stack_pool_set_high_water_all(uint32_t high_water)
+{
+    for (uint32_t i = 0; i < stack_pool_count; i++)
+    {
+        stack_pool_set_high_water(&stack_pools[i], high_water);
+    }
+}
+
+void stack_pool_print_stats(void)
+{
+    vga_print("POOL\tSIZE\tGUARD\tUSED\tIDLE\tMAX\tHITS\tMISSES\tHELD\n");
+
+    for (uint32_t i = 0; i < stack_pool_count; i++)
+    {
+        stack_pool_t *pool = &stack_pools[i];
+
+        vga_print(pool->name);
+        vga_print("\t");
+        vga_print_dec(pool->stack_size);
+        vga_print("\t");
+        vga_print(pool->guard ? "yes" : "no");
+        vga_print("\t");
+        vga_print_dec(pool->in_use);
+        vga_print("\t");
+        vga_print_dec(pool->idle);
+        vga_print("\t");
+        vga_print_dec(pool->high_water);
+        vga_print("\t");
+        vga_print_dec(pool->hits);
+        vga_print("\t");
+        vga_print_dec(pool->misses);
+        vga_print("\t");
+        vga_print_dec(pool->idle * (PAGE_SIZE << pool->order));
+        vga_print("\n");
+
+        if (pool->guard_failures)
+        {
+            vga_print("  guard pages hit: ");
+            vga_print_dec(pool->guard_failures);
+            vga_print("\n");
+        }
+    }
+
+    if (stack_pool_count == 0)
+    {
+        vga_print("(No pools)\n");
+    }
+}
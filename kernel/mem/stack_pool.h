@@ -0,0 +1,47 @@
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#include "../kernel.h"
+
+// Stack pool configuration
+#define STACK_POOL_MAX_POOLS 4
+#define STACK_POOL_HIGH_WATER 16       // Idle stacks kept per pool by default
+#define STACK_GUARD_PATTERN 0x6A6A6A6A // Fill of software guard pages
+
+// Guard pages below kernel stacks are on unless building for release
+#ifndef STACK_POOL_GUARD
+#ifdef KERNEL_RELEASE
+#define STACK_POOL_GUARD 0
+#else
+#define STACK_POOL_GUARD 1
+#endif
+#endif
+
+// Page-aligned stacks of one size, recycled without zeroing
+typedef struct stack_pool
+{
+    const char *name;
+    uint32_t stack_size; // Usable bytes per stack (whole pages)
+    uint32_t order;      // Buddy order of one block (stack plus guard page)
+    bool guard;          // Lowest page of each block is a guard
+    uint32_t high_water; // Idle stacks kept; beyond this they go back to the PMM
+
+    void *idle_list; // Idle stacks, linked through their lowest word
+    uint32_t idle;   // Stacks on the idle list
+    uint32_t in_use; // Stacks handed out
+
+    // Statistics
+    uint32_t hits;           // Gets served from the idle list
+    uint32_t misses;         // Gets that went to the frame allocator
+    uint32_t guard_failures; // Stacks returned with a damaged guard page
+} stack_pool_t;
+
+// Stack pool API
+stack_pool_t *stack_pool_create(const char *name, uint32_t stack_size, bool guard, uint32_t high_water);
+uint32_t stack_pool_get(stack_pool_t *pool);
+void stack_pool_put(stack_pool_t *pool, uint32_t base);
+void stack_pool_set_high_water(stack_pool_t *pool, uint32_t high_water);
+void stack_pool_set_high_water_all(uint32_t high_water);
+void stack_pool_print_stats(void);
+
+#endif
@@ -0,0 +1,401 @@
+/* Virtual Memory Manager - x86 two-level paging
+ *
+ * The low KERNEL_SPACE_END bytes are identity-mapped with 4MB (PSE) pages
+ * marked global, so the whole kernel costs a handful of TLB entries and
+ * those entries survive the CR3 reload on every context switch. Each page
+ * directory copies the kernel entries, sharing the kernel half by
+ * reference; process space above it is mapped with ordinary 4KB pages.
+ *
+ * Page tables come from the frame allocator and are reached through the
+ * identity map, so physical and virtual addresses of tables are the same.
+ *
+ * Process-space frames are reference counted. A cloned directory shares
+ * every page read-only with PAGE_COW set, and the first write from either
+ * side copies the page (or just re-enables writes if it is the last user).
+ */
+
+#include "vmm.h"
+#include "../arch/cpu.h"
+
+#define PDE_INDEX(addr) ((addr) >> 22)
+#define PTE_INDEX(addr) (((addr) >> PAGE_SHIFT) & (ENTRIES_PER_TABLE - 1))
+#define ENTRY_FRAME(entry) ((entry) & ~(PAGE_SIZE - 1))
+
+static uint32_t *kernel_directory = NULL;
+static bool paging_enabled = false;
+
+// Also written by context_switch in context_switch.asm
+uint32_t vmm_active_cr3 = 0;
+
+static inline uint32_t read_cr3(void)
+{
+    uint32_t value;
+    asm volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr3(uint32_t value)
+{
+    asm volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+    vmm_active_cr3 = value;
+}
+
+static inline void invlpg(uint32_t addr)
+{
+    asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/**
+ * Allocate a zeroed frame for a page directory or page table
+ */
+static uint32_t *vmm_alloc_table(void)
+{
+    return (uint32_t *)pmm_alloc_zeroed_frame();
+}
+
+/**
+ * Invalidate a TLB entry if the directory is the active one
+ */
+static inline void vmm_invalidate(uint32_t *directory, uint32_t virt)
+{
+    if ((uint32_t)directory == read_cr3())
+    {
+        invlpg(virt);
+    }
+}
+
+/**
+ * Build the kernel page directory and turn paging on
+ */
+void vmm_init(void)
+{
+    uint32_t features = cpu_features();
+
+    if (!(features & CPUID_FEATURE_PSE))
+    {
+        vga_print("  VMM: CPU lacks 4MB pages (PSE), paging left off\n");
+        return;
+    }
+
+    kernel_directory = vmm_alloc_table();
+    if (!kernel_directory)
+    {
+        vga_print("  VMM: no frame for the kernel page directory\n");
+        return;
+    }
+
+    uint32_t flags = PAGE_PRESENT | PAGE_WRITABLE | PAGE_LARGE;
+    if (features & CPUID_FEATURE_PGE)
+    {
+        flags |= PAGE_GLOBAL;
+    }
+
+    // Identity-map the kernel half with 4MB pages
+    for (uint32_t i = 0; i < KERNEL_PDE_COUNT; i++)
+    {
+        kernel_directory[i] = (i * LARGE_PAGE_SIZE) | flags;
+    }
+
+    write_cr4(read_cr4() | CR4_PSE);
+    write_cr3((uint32_t)kernel_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+
+    if (features & CPUID_FEATURE_PGE)
+    {
+        write_cr4(read_cr4() | CR4_PGE);
+    }
+
+    paging_enabled = true;
+
+    vga_print("  VMM: kernel mapped with ");
+    vga_print_dec(KERNEL_PDE_COUNT);
+    vga_print((features & CPUID_FEATURE_PGE) ? " global 4MB pages\n" : " 4MB pages\n");
+}
+
+bool vmm_is_enabled(void)
+{
+    return paging_enabled;
+}
+
+uint32_t *vmm_kernel_directory(void)
+{
+    return kernel_directory;
+}
+
+/**
+ * Create a page directory for a process. The kernel entries are copied,
+ * so every directory shares the same kernel mappings.
+ */
+uint32_t *vmm_create_directory(void)
+{
+    if (!paging_enabled)
+        return NULL;
+
+    uint32_t *directory = vmm_alloc_table();
+    if (!directory)
+        return NULL;
+
+    for (uint32_t i = 0; i < KERNEL_PDE_COUNT; i++)
+    {
+        directory[i] = kernel_directory[i];
+    }
+
+    return directory;
+}
+
+/**
+ * Free a process page directory together with its page tables and every
+ * frame mapped into process space
+ */
+void vmm_destroy_directory(uint32_t *directory)
+{
+    if (!directory || directory == kernel_directory)
+        return;
+
+    for (uint32_t i = KERNEL_PDE_COUNT; i < ENTRIES_PER_TABLE; i++)
+    {
+        uint32_t pde = directory[i];
+        if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE))
+            continue;
+
+        uint32_t *table = (uint32_t *)ENTRY_FRAME(pde);
+        for (uint32_t j = 0; j < ENTRIES_PER_TABLE; j++)
+        {
+            if (table[j] & PAGE_PRESENT)
+            {
+                pmm_frame_put(ENTRY_FRAME(table[j]));
+            }
+        }
+        pmm_free_frame((uint32_t)table);
+    }
+
+    // Never free the directory we are running on
+    if ((uint32_t)directory == read_cr3())
+    {
+        write_cr3((uint32_t)kernel_directory);
+    }
+    pmm_free_frame((uint32_t)directory);
+}
+
+/**
+ * Clone a directory for fork. Page tables are copied; the pages themselves
+ * are shared copy-on-write. Returns the new directory (NULL if out of
+ * memory) and the number of shared pages in `shared_pages`.
+ */
+uint32_t *vmm_clone_directory(uint32_t *parent, uint32_t *shared_pages)
+{
+    uint32_t *child = vmm_create_directory();
+    uint32_t shared = 0;
+
+    if (!child || !parent)
+        return child;
+
+    for (uint32_t i = KERNEL_PDE_COUNT; i < ENTRIES_PER_TABLE; i++)
+    {
+        uint32_t pde = parent[i];
+        if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE))
+            continue;
+
+        uint32_t *child_table = vmm_alloc_table();
+        if (!child_table)
+        {
+            vmm_destroy_directory(child);
+            return NULL;
+        }
+
+        uint32_t *parent_table = (uint32_t *)ENTRY_FRAME(pde);
+        for (uint32_t j = 0; j < ENTRIES_PER_TABLE; j++)
+        {
+            uint32_t pte = parent_table[j];
+            if (!(pte & PAGE_PRESENT))
+                continue;
+
+            if (pte & (PAGE_WRITABLE | PAGE_COW))
+            {
+                pte = (pte & ~PAGE_WRITABLE) | PAGE_COW;
+                parent_table[j] = pte;
+            }
+            child_table[j] = pte;
+            pmm_frame_get(ENTRY_FRAME(pte));
+            shared++;
+        }
+
+        child[i] = (uint32_t)child_table | (pde & (PAGE_SIZE - 1));
+    }
+
+    // The parent's writable entries just became read-only
+    if ((uint32_t)parent == read_cr3())
+    {
+        vmm_flush_tlb();
+    }
+
+    if (shared_pages)
+    {
+        *shared_pages = shared;
+    }
+    return child;
+}
+
+/**
+ * Resolve a write fault on a copy-on-write page. Returns VMM_COW_NONE if
+ * the page is not copy-on-write, VMM_COW_REUSED if this was the last
+ * reference and the page simply became writable, or VMM_COW_COPIED.
+ */
+int vmm_handle_cow_fault(uint32_t *directory, uint32_t virt)
+{
+    if (!directory || virt < KERNEL_SPACE_END)
+        return VMM_COW_NONE;
+
+    uint32_t pde = directory[PDE_INDEX(virt)];
+    if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE))
+        return VMM_COW_NONE;
+
+    uint32_t *pte = &((uint32_t *)ENTRY_FRAME(pde))[PTE_INDEX(virt)];
+    if (!(*pte & PAGE_PRESENT) || !(*pte & PAGE_COW))
+        return VMM_COW_NONE;
+
+    uint32_t frame = ENTRY_FRAME(*pte);
+    uint32_t flags = (*pte & (PAGE_SIZE - 1) & ~PAGE_COW) | PAGE_WRITABLE;
+    int result = VMM_COW_REUSED;
+
+    if (pmm_frame_refcount(frame) > 1)
+    {
+        uint32_t copy = pmm_alloc_frame();
+        if (!copy)
+            return VMM_COW_NONE; // Out of memory: leave it as a fatal fault
+
+        memcpy((void *)copy, (void *)frame, PAGE_SIZE);
+        pmm_frame_put(frame);
+        frame = copy;
+        result = VMM_COW_COPIED;
+    }
+
+    *pte = frame | flags;
+    vmm_invalidate(directory, virt);
+    return result;
+}
+
+void vmm_switch_directory(uint32_t *directory)
+{
+    if (directory && (uint32_t)directory != read_cr3())
+    {
+        write_cr3((uint32_t)directory);
+    }
+}
+
+/**
+ * Directory of the running task. Unlike CR3 this stays correct inside the
+ * page-fault task, which runs on the kernel directory.
+ */
+uint32_t *vmm_current_directory(void)
+{
+    return (uint32_t *)vmm_active_cr3;
+}
+
+/**
+ * Drop all non-global TLB entries
+ */
+void vmm_flush_tlb(void)
+{
+    write_cr3(read_cr3());
+}
+
+/**
+ * Map one 4KB page outside the kernel half
+ */
+bool vmm_map_page(uint32_t *directory, uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    if (!directory || virt < KERNEL_SPACE_END)
+        return false;
+
+    uint32_t *pde = &directory[PDE_INDEX(virt)];
+    if (*pde & PAGE_LARGE)
+        return false; // Already covered by a 4MB page
+
+    if (!(*pde & PAGE_PRESENT))
+    {
+        uint32_t *table = vmm_alloc_table();
+        if (!table)
+            return false;
+        *pde = (uint32_t)table | PAGE_PRESENT | PAGE_WRITABLE | (flags & PAGE_USER);
+    }
+
+    uint32_t *table = (uint32_t *)ENTRY_FRAME(*pde);
+    table[PTE_INDEX(virt)] = ENTRY_FRAME(phys) | (flags & (PAGE_SIZE - 1)) | PAGE_PRESENT;
+    vmm_invalidate(directory, virt);
+
+    return true;
+}
+
+/**
+ * Map one 4MB page outside the kernel half (both addresses 4MB aligned)
+ */
+bool vmm_map_large_page(uint32_t *directory, uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    if (!directory || virt < KERNEL_SPACE_END || (virt | phys) & (LARGE_PAGE_SIZE - 1))
+        return false;
+
+    uint32_t *pde = &directory[PDE_INDEX(virt)];
+    if ((*pde & PAGE_PRESENT) && !(*pde & PAGE_LARGE))
+        return false; // A page table already covers this range
+
+    *pde = phys | (flags & (PAGE_SIZE - 1)) | PAGE_PRESENT | PAGE_LARGE;
+    vmm_invalidate(directory, virt);
+
+    return true;
+}
+
+/**
+ * Remove the mapping at `virt` (the whole 4MB page for large mappings).
+ * Returns the physical frame that was mapped, or 0.
+ */
+uint32_t vmm_unmap_page(uint32_t *directory, uint32_t virt)
+{
+    if (!directory || virt < KERNEL_SPACE_END)
+        return 0;
+
+    uint32_t *pde = &directory[PDE_INDEX(virt)];
+    if (!(*pde & PAGE_PRESENT))
+        return 0;
+
+    uint32_t phys;
+    if (*pde & PAGE_LARGE)
+    {
+        phys = ENTRY_FRAME(*pde);
+        *pde = 0;
+    }
+    else
+    {
+        uint32_t *table = (uint32_t *)ENTRY_FRAME(*pde);
+        uint32_t *pte = &table[PTE_INDEX(virt)];
+        if (!(*pte & PAGE_PRESENT))
+            return 0;
+        phys = ENTRY_FRAME(*pte);
+        *pte = 0;
+    }
+
+    vmm_invalidate(directory, virt);
+    return phys;
+}
+
+/**
+ * Translate a virtual address. Returns the physical address, or 0 if unmapped.
+ */
+uint32_t vmm_translate(uint32_t *directory, uint32_t virt)
+{
+    if (!directory)
+        return virt; // Paging off: identity
+
+    uint32_t pde = directory[PDE_INDEX(virt)];
+    if (!(pde & PAGE_PRESENT))
+        return 0;
+
+    if (pde & PAGE_LARGE)
+        return (pde & ~(LARGE_PAGE_SIZE - 1)) | (virt & (LARGE_PAGE_SIZE - 1));
+
+    uint32_t pte = ((uint32_t *)ENTRY_FRAME(pde))[PTE_INDEX(virt)];
+    if (!(pte & PAGE_PRESENT))
+        return 0;
+
+    return ENTRY_FRAME(pte) | (virt & (PAGE_SIZE - 1));
+}
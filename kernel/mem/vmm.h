@@ -0,0 +1,63 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include "../kernel.h"
+#include "pmm.h"
+
+// Page directory/table entry flags
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITABLE 0x002
+#define PAGE_USER 0x004
+#define PAGE_ACCESSED 0x020
+#define PAGE_DIRTY 0x040
+#define PAGE_LARGE 0x080  // 4MB page (directory entries only, needs CR4.PSE)
+#define PAGE_GLOBAL 0x100 // Kept in the TLB across CR3 reloads (needs CR4.PGE)
+#define PAGE_COW 0x200    // Shared read-only until written (available bit)
+
+#define LARGE_PAGE_SIZE 0x400000
+#define ENTRIES_PER_TABLE 1024
+
+// Address space layout
+#define KERNEL_SPACE_END 0x40000000 // Low 1GB: identity-mapped, shared by every directory
+#define KERNEL_PDE_COUNT (KERNEL_SPACE_END / LARGE_PAGE_SIZE)
+#define PROCESS_SPACE_START KERNEL_SPACE_END
+#define PROCESS_SPACE_END 0xC0000000 // Per-process mappings live below this
+#define VMM_SCRATCH_BASE 0xC0000000  // Kernel-directory-only scratch mappings
+
+// Demand-paged process regions (faulted in by process_handle_page_fault)
+#define PROCESS_HEAP_BASE PROCESS_SPACE_START
+#define PROCESS_STACK_TOP PROCESS_SPACE_END
+#define PROCESS_STACK_RESERVE 0x100000 // 1MB reserved, lowest page is the guard
+#define PROCESS_HEAP_LIMIT (PROCESS_STACK_TOP - PROCESS_STACK_RESERVE) // Highest break
+
+// Page fault error code bits
+#define PAGE_FAULT_PRESENT 0x1 // Protection violation (clear: page not present)
+#define PAGE_FAULT_WRITE 0x2
+#define PAGE_FAULT_USER 0x4
+
+// vmm_handle_cow_fault results
+#define VMM_COW_NONE 0   // Not a copy-on-write page
+#define VMM_COW_REUSED 1 // Last reference: made writable in place
+#define VMM_COW_COPIED 2 // Page copied for this address space
+
+// CR3 of the running task (read by the page-fault task to resume it)
+extern uint32_t vmm_active_cr3;
+
+// Virtual memory manager
+void vmm_init(void);
+bool vmm_is_enabled(void);
+uint32_t *vmm_kernel_directory(void);
+uint32_t *vmm_create_directory(void);
+void vmm_destroy_directory(uint32_t *directory);
+uint32_t *vmm_clone_directory(uint32_t *parent, uint32_t *shared_pages);
+int vmm_handle_cow_fault(uint32_t *directory, uint32_t virt);
+void vmm_switch_directory(uint32_t *directory);
+uint32_t *vmm_current_directory(void);
+void vmm_flush_tlb(void);
+
+bool vmm_map_page(uint32_t *directory, uint32_t virt, uint32_t phys, uint32_t flags);
+bool vmm_map_large_page(uint32_t *directory, uint32_t virt, uint32_t phys, uint32_t flags);
+uint32_t vmm_unmap_page(uint32_t *directory, uint32_t virt);
+uint32_t vmm_translate(uint32_t *directory, uint32_t virt);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+// Value in EAX when a multiboot loader hands over control
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+// multiboot_info_t.flags bits
+#define MULTIBOOT_INFO_MEMORY 0x001  // mem_lower/mem_upper are valid
+#define MULTIBOOT_INFO_CMDLINE 0x004 // cmdline is valid
+#define MULTIBOOT_INFO_MEM_MAP 0x040 // mmap_addr/mmap_length are valid
+
+// Memory map entry types
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+// Boot information passed by the loader (fields we do not use are kept for layout)
+typedef struct
+{
+    uint32_t flags;
+    uint32_t mem_lower; // KB of memory below 1MB
+    uint32_t mem_upper; // KB of memory above 1MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+// One entry of the memory map; `size` does not count itself
+typedef struct
+{
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
@@ -1,4 +1,5 @@
 #include "process.h"
+#include "../syscalls.h"
 // Demo program for exec syscall: prints hello message
 void exec_hello_program(void)
 {
@@ -103,7 +104,7 @@ void process_stress_test(void)
         name[4] = '0' + i;
         name[5] = '\0';
 
-        vga_print("DEBUG: Creating process ");
+        vga_print("Creating process ");
         vga_print(name);
         vga_print("...\n");
 
@@ -111,16 +112,13 @@ void process_stress_test(void)
 
         if (proc)
         {
-            vga_print("DEBUG: Successfully created process with PID ");
-            if (proc->pid < 10)
-            {
-                vga_putchar('0' + proc->pid);
-            }
+            vga_print("Created process with PID ");
+            vga_print_dec(proc->pid);
             vga_print("\n");
         }
         else
         {
-            vga_print("DEBUG: Failed to create process ");
+            vga_print("Failed to create process ");
             vga_print(name);
             vga_print("\n");
             break; // Stop if we fail to create a process
@@ -133,3 +131,41 @@ void process_stress_test(void)
 
     vga_print("Stress test processes created!\n");
 }
+
+/**
+ * Demo process that forks: parent and child report what fork returned,
+ * the child reports how many shared pages it has copied by writing, and
+ * the parent reaps it
+ */
+void demo_fork_process(void)
+{
+    uint32_t pid = sys_fork();
+    if (pid == (uint32_t)-1)
+    {
+        vga_print("forker: fork failed\n");
+        process_exit(1);
+    }
+
+    if (pid == 0)
+    {
+        vga_print("forker child: fork returned 0, PID ");
+        vga_print_dec(sys_getpid());
+        vga_print(", copied ");
+        vga_print_dec(current_process->cow_copied_pages);
+        vga_print(" of ");
+        vga_print_dec(current_process->cow_shared_pages);
+        vga_print(" shared pages\n");
+        process_exit(0);
+    }
+
+    vga_print("forker parent: fork returned ");
+    vga_print_dec(pid);
+    vga_print("\n");
+
+    uint32_t status = 0;
+    sys_waitpid((int32_t)pid, &status, 0);
+    vga_print("forker parent: child exited with ");
+    vga_print_dec(status);
+    vga_print("\n");
+    process_exit(0);
+}
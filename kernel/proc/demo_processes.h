@@ -6,6 +6,7 @@ void exec_hello_program(void);
 void demo_counter_process(void);
 void demo_calc_process(void);
 void demo_monitor_process(void);
+void demo_fork_process(void);
 
 
 #endif // DEMO_PROCESSES_H
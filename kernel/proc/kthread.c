@@ -0,0 +1,150 @@
+/* Kernel Threads
+ *
+ * A kernel thread is a process_t the scheduler runs like any other, but
+ * creating one skips everything a process needs and a thread does not:
+ * no page directory (it runs in whichever address space is loaded, where
+ * the kernel is always mapped, so switching to it costs no CR3 reload),
+ * no demand-paged stack, no file descriptors. Its stack is half a page
+ * from a free list of its own, so a thread comes and goes without
+ * touching the frame allocator once the pool has warmed up.
+ */
+
+#include "kthread.h"
+#include "../mem/pmm.h"
+#include "../log.h"
+
+static void *kthread_stack_free = NULL; // Free stacks, linked through their lowest word
+
+// Statistics
+static uint32_t kthread_stack_frames = 0;
+static uint32_t kthread_stacks_in_use = 0;
+static uint32_t kthread_canary_failures = 0;
+
+static void *kthread_stack_get(void)
+{
+    if (!kthread_stack_free)
+    {
+        uint32_t frame = pmm_alloc_frame();
+        if (!frame)
+            return NULL;
+
+        kthread_stack_frames++;
+        for (uint32_t offset = 0; offset < PAGE_SIZE; offset += KTHREAD_STACK_SIZE)
+        {
+            void **stack = (void **)(frame + offset);
+            *stack = kthread_stack_free;
+            kthread_stack_free = stack;
+        }
+    }
+
+    void **stack = kthread_stack_free;
+    kthread_stack_free = *stack;
+    *(uint32_t *)stack = KTHREAD_STACK_CANARY;
+    kthread_stacks_in_use++;
+    return stack;
+}
+
+void kthread_release_stack(process_t *thread)
+{
+    uint32_t *stack = (uint32_t *)thread->stack_base;
+    if (!stack)
+        return;
+
+    if (*stack != KTHREAD_STACK_CANARY)
+    {
+        LOG_WARN("kthread", "Stack overflow detected\n");
+        kthread_canary_failures++;
+    }
+
+    *(void **)stack = kthread_stack_free;
+    kthread_stack_free = stack;
+    kthread_stacks_in_use--;
+
+    thread->stack_base = 0;
+    thread->stack_size = 0;
+}
+
+/**
+ * First code a thread runs: its function, then a clean exit
+ */
+static void kthread_entry(kthread_fn_t fn, void *arg)
+{
+    fn(arg);
+    kthread_exit(0);
+}
+
+/**
+ * Create a runnable kernel thread calling fn(arg), as a child of the
+ * current process. Returns NULL when out of PIDs or memory.
+ */
+process_t *kthread_create(const char *name, kthread_fn_t fn, void *arg)
+{
+    process_t *thread = process_alloc(name, PRIORITY_NORMAL);
+    if (!thread)
+        return NULL;
+
+    uint32_t *stack = kthread_stack_get();
+    if (!stack)
+    {
+        process_free_pcb(thread);
+        return NULL;
+    }
+
+    thread->flags |= PROCESS_FLAG_KTHREAD;
+    thread->stack_base = (uint32_t)stack;
+    thread->stack_size = KTHREAD_STACK_SIZE;
+
+    // kthread_entry(fn, arg) with a null return address above it
+    uint32_t *top = (uint32_t *)((uint32_t)stack + KTHREAD_STACK_SIZE);
+    top[-1] = (uint32_t)arg;
+    top[-2] = (uint32_t)fn;
+    top[-3] = 0;
+
+    thread->cpu_state.eip = (uint32_t)kthread_entry;
+    thread->cpu_state.esp = (uint32_t)&top[-3];
+    thread->cpu_state.eflags = 0x202; // Enable interrupts flag
+    thread->cpu_state.cs = 0x08;      // Kernel code segment
+
+    process_start(thread);
+    return thread;
+}
+
+/**
+ * Wait for a thread created by the current process to finish and free
+ * it. Returns its exit code, or PROCESS_ERROR if it is not ours to join.
+ */
+int kthread_join(process_t *thread)
+{
+    if (!thread || !current_process || thread->parent != current_process)
+        return PROCESS_ERROR;
+
+    uint32_t flags = irq_save();
+    while (thread->state != PROCESS_TERMINATED)
+    {
+        wait_queue_sleep(&current_process->child_exit);
+    }
+
+    int exit_code = thread->exit_code;
+    process_cleanup(thread);
+    irq_restore(flags);
+    return exit_code;
+}
+
+/**
+ * End the current thread; a joiner gets `exit_code`
+ */
+void kthread_exit(int exit_code)
+{
+    process_exit(exit_code);
+}
+
+void kthread_print_stats(void)
+{
+    vga_print("Kernel thread stacks: ");
+    vga_print_dec(kthread_stacks_in_use);
+    vga_print(" in use, ");
+    vga_print_dec(kthread_stack_frames * (PAGE_SIZE / KTHREAD_STACK_SIZE) - kthread_stacks_in_use);
+    vga_print(" free, ");
+    vga_print_dec(kthread_canary_failures);
+    vga_print(" overflows\n");
+}
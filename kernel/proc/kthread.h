@@ -0,0 +1,22 @@
+#ifndef KTHREAD_H
+#define KTHREAD_H
+
+#include "process.h"
+
+// Kernel thread stacks: two per page, carved from frames kept by the pool
+#define KTHREAD_STACK_SIZE 2048
+#define KTHREAD_STACK_CANARY 0x6B6B6B6B // Lowest word of every stack
+
+typedef void (*kthread_fn_t)(void *arg);
+
+// Kernel threads: processes without an address space or fd table, on
+// small pooled stacks. Only the creating process may join a thread.
+process_t *kthread_create(const char *name, kthread_fn_t fn, void *arg);
+int kthread_join(process_t *thread);
+void kthread_exit(int exit_code);
+
+// Used by the process manager when a thread's PCB goes
+void kthread_release_stack(process_t *thread);
+void kthread_print_stats(void);
+
+#endif
@@ -0,0 +1,81 @@
+/* PID Allocator
+ *
+ * One bit per PID. Allocation continues from the last PID handed out
+ * and scans a word at a time for a clear bit, so it skips 32 taken PIDs
+ * per step and never revisits a freed PID until it wraps around. That
+ * delay keeps a stale PID (say, one a shell command just printed) from
+ * naming a brand-new process right away.
+ */
+
+#include "pid.h"
+
+static uint32_t pid_bitmap[PID_BITMAP_WORDS];
+static uint32_t pid_last = 0; // Most recently allocated PID
+static uint32_t pid_count = 0;
+
+/**
+ * First clear bit at or after `start`, or PID_MAX if there is none
+ */
+static uint32_t pid_find_free(uint32_t start, uint32_t end)
+{
+    uint32_t word = start / 32;
+    uint32_t free = ~pid_bitmap[word] & (0xFFFFFFFFu << (start % 32));
+
+    while (!free)
+    {
+        if (++word * 32 >= end)
+            return PID_MAX;
+        free = ~pid_bitmap[word];
+    }
+
+    uint32_t pid = word * 32 + __builtin_ctz(free);
+    return pid < end ? pid : PID_MAX;
+}
+
+void pid_init(void)
+{
+    for (uint32_t i = 0; i < PID_BITMAP_WORDS; i++)
+    {
+        pid_bitmap[i] = 0;
+    }
+    pid_bitmap[0] = 1; // PID 0 is never handed out
+    pid_last = 0;
+    pid_count = 0;
+}
+
+/**
+ * Allocate the next free PID after the last one. Returns 0 when all are taken.
+ */
+uint32_t pid_alloc(void)
+{
+    uint32_t pid = pid_last + 1 < PID_MAX ? pid_find_free(pid_last + 1, PID_MAX) : PID_MAX;
+    if (pid == PID_MAX)
+    {
+        pid = pid_find_free(1, pid_last + 1); // Wrap around
+        if (pid == PID_MAX)
+            return 0;
+    }
+
+    pid_bitmap[pid / 32] |= 1u << (pid % 32);
+    pid_last = pid;
+    pid_count++;
+    return pid;
+}
+
+void pid_free(uint32_t pid)
+{
+    if (!pid || pid >= PID_MAX)
+        return;
+
+    uint32_t bit = 1u << (pid % 32);
+    if (pid_bitmap[pid / 32] & bit)
+    {
+        pid_bitmap[pid / 32] &= ~bit;
+        pid_count--;
+    }
+}
+
+uint32_t pid_in_use(void)
+{
+    return pid_count;
+}
@@ -0,0 +1,16 @@
+#ifndef PID_H
+#define PID_H
+
+#include "kernel.h"
+
+// PID space. PIDs are handed out round-robin from a bitmap, so a freed
+// PID is only reused after the rest of the space has been used once.
+#define PID_MAX 32768 // PIDs are 1..PID_MAX-1; 0 means none
+#define PID_BITMAP_WORDS (PID_MAX / 32)
+
+uint32_t pid_alloc(void);
+void pid_free(uint32_t pid);
+void pid_init(void);
+uint32_t pid_in_use(void);
+
+#endif
@@ -1,10 +1,37 @@
 #include "process.h"
+#include "sched.h"
+#include "pid.h"
+#include "kthread.h"
+#include "../mem/slab.h"
+#include "../mem/vmm.h"
+#include "../mem/stack_pool.h"
+#include "../arch/fpu.h"
+#include "../drivers/timer.h"
+#include "../log.h"
+
+// context_switch.asm hard-codes these offsets
+_Static_assert(offsetof(process_t, cpu_state) == 84, "update CPU_STATE_OFFSET in context_switch.asm");
+_Static_assert(offsetof(process_t, page_directory) == 148, "update PAGE_DIRECTORY_OFFSET in context_switch.asm");
+_Static_assert(offsetof(process_t, kernel_esp) == 156, "update KERNEL_ESP_OFFSET in context_switch.asm");
 
 // Global process management state
-process_t *process_table[MAX_PROCESSES];
-static uint32_t next_pid = 1;
-static process_t *ready_queue_head = NULL;
-static process_t *ready_queue_tail = NULL;
+process_t *process_list = NULL;
+static process_t *process_list_tail = NULL;
+uint32_t process_count = 0;
+
+// PID lookup table; buckets chain through hash_next
+static process_t *pid_hash[PID_HASH_SIZE];
+
+// Exited processes nobody will wait for, left for the idle task to reap
+static uint32_t orphan_zombies = 0;
+
+// PCBs come from a slab cache instead of the heap
+static slab_cache_t *process_cache = NULL;
+
+// Recycled stacks: kernel-space stacks for processes without an address
+// space, and the initially mapped top page of demand-paged stacks
+static stack_pool_t *kernel_stack_pool = NULL;
+static stack_pool_t *process_stack_pool = NULL;
 
 // Current running process and kernel idle process
 process_t *current_process = NULL;
@@ -12,8 +39,141 @@ process_t *kernel_process = NULL;
 
 // Forward declarations
 static void process_idle_task(void);
+static void process_sleep_expired(void *data);
+static void process_register(process_t *process);
+static void process_unregister(process_t *process);
 process_t *process_create_test(const char *name, void *entry_point, process_priority_t priority);
 
+/**
+ * PCB constructor - free PCBs in the cache are always zeroed
+ */
+static void process_ctor(void *object)
+{
+    memset(object, 0, sizeof(process_t));
+}
+
+/**
+ * Return a PCB to the process cache in its constructed state
+ */
+void process_free_pcb(process_t *process)
+{
+    ktimer_cancel(&process->sleep_timer);
+    edf_release(process);
+    wait_queue_remove(process);
+    fpu_release(process);
+    pid_free(process->pid);
+    process_ctor(process);
+    slab_free(process_cache, process);
+}
+
+/**
+ * Release a process stack to its pool. Only the top page of a demand-paged
+ * stack is recycled; the rest is freed along with the page directory.
+ */
+static void process_release_stack(process_t *process)
+{
+    if (!process->stack_base)
+        return;
+
+    if (process->flags & PROCESS_FLAG_KTHREAD)
+    {
+        kthread_release_stack(process);
+        return;
+    }
+
+    if (process->stack_base >= PROCESS_SPACE_START)
+    {
+        uint32_t frame = vmm_unmap_page(process->page_directory, PROCESS_STACK_TOP - PAGE_SIZE);
+
+        // A page still shared with a forked relative is not ours to recycle
+        if (frame && pmm_frame_refcount(frame) == 1)
+            stack_pool_put(process_stack_pool, frame);
+        else if (frame)
+            pmm_frame_put(frame);
+    }
+    else
+    {
+        stack_pool_put(kernel_stack_pool, process->stack_base);
+    }
+
+    process->stack_base = 0;
+    process->stack_size = 0;
+}
+
+/**
+ * Give a process its page directory. The first process is the kernel idle
+ * task, which runs the shell on the kernel directory itself.
+ * Returns false if paging is on and no directory could be allocated.
+ */
+static bool process_attach_directory(process_t *process)
+{
+    if (!vmm_is_enabled())
+        return true; // Paging off: everyone shares the physical address space
+
+    process->page_directory = kernel_process ? vmm_create_directory() : vmm_kernel_directory();
+    return process->page_directory != NULL;
+}
+
+/**
+ * True if the process runs in its own page directory rather than the kernel's
+ */
+static bool process_has_address_space(process_t *process)
+{
+    return process->page_directory && process->page_directory != vmm_kernel_directory();
+}
+
+/**
+ * Back one page of a process address space with a zeroed frame
+ */
+static bool process_map_zeroed_page(uint32_t *directory, uint32_t virt)
+{
+    uint32_t frame = pmm_alloc_zeroed_frame();
+    if (!frame)
+        return false;
+
+    if (!vmm_map_page(directory, virt, frame, PAGE_WRITABLE))
+    {
+        pmm_free_frame(frame);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reserve a demand-paged stack: PROCESS_STACK_RESERVE bytes below
+ * PROCESS_STACK_TOP with only the top page mapped. The page-fault handler
+ * maps the rest on first touch; the lowest page is never mapped and
+ * catches overflows. Returns the initial stack top, or 0 if out of memory.
+ */
+static uint32_t process_map_stack(process_t *process)
+{
+    // A recycled page: a fresh stack needs no clearing
+    uint32_t frame = stack_pool_get(process_stack_pool);
+    if (!frame)
+        return 0;
+
+    if (!vmm_map_page(process->page_directory, PROCESS_STACK_TOP - PAGE_SIZE, frame, PAGE_WRITABLE))
+    {
+        stack_pool_put(process_stack_pool, frame);
+        return 0;
+    }
+
+    process->stack_base = PROCESS_STACK_TOP - PROCESS_STACK_RESERVE;
+    process->stack_size = PAGE_SIZE; // Committed so far
+    process->memory_used = PAGE_SIZE;
+    return PROCESS_STACK_TOP;
+}
+
+/**
+ * Release a process page directory and everything mapped in its process space
+ */
+static void process_release_directory(process_t *process)
+{
+    vmm_destroy_directory(process->page_directory);
+    process->page_directory = NULL;
+}
+
 /**
  * Initialize the process management subsystem
  */
@@ -22,9 +182,26 @@ void process_init(void)
     vga_print("  Initializing process table...\n");
 
     // Initialize process table
-    for (int i = 0; i < MAX_PROCESSES; i++)
+    for (int i = 0; i < PID_HASH_SIZE; i++)
+    {
+        pid_hash[i] = NULL;
+    }
+    process_list = NULL;
+    process_list_tail = NULL;
+    process_count = 0;
+    pid_init();
+
+    // Cache-line aligned PCBs, constructed once per slab
+    if (!process_cache)
+    {
+        process_cache = slab_cache_create("process_t", sizeof(process_t), CACHE_LINE_SIZE, process_ctor);
+    }
+
+    // Demand-paged stacks already have an unmapped guard page of their own
+    if (!kernel_stack_pool)
     {
-        process_table[i] = NULL;
+        kernel_stack_pool = stack_pool_create("kstack", STACK_SIZE, STACK_POOL_GUARD, STACK_POOL_HIGH_WATER);
+        process_stack_pool = stack_pool_create("pstack", PAGE_SIZE, false, STACK_POOL_HIGH_WATER);
     }
 
     vga_print("  Process table initialized...\n");
@@ -32,9 +209,6 @@ void process_init(void)
     // Initialize global state
     current_process = NULL;
     kernel_process = NULL;
-    next_pid = 1;
-    ready_queue_head = NULL;
-    ready_queue_tail = NULL;
 
     vga_print("  Process management ready\n");
 }
@@ -44,81 +218,106 @@ void process_init(void)
  */
 process_t *process_create(const char *name, void *entry_point, process_priority_t priority)
 {
-    vga_print("DEBUG: process_create called\n");
+    LOG_DEBUG("proc", "process_create called\n");
 
     // Validate inputs first
     if (!name)
     {
-        vga_print("DEBUG: Invalid name parameter\n");
+        LOG_WARN("proc", "Invalid name parameter\n");
         return NULL;
     }
 
-    vga_print("DEBUG: Checking process count\n");
-
-    // Use hybrid approach: static PCBs + dynamic memory for stacks
-    static process_t static_processes[10];
-    static int process_count = 0;
+    LOG_TRACE("proc", "Allocating PCB\n");
+    process_t *process = slab_alloc(process_cache);
+    if (!process)
+    {
+        LOG_WARN("proc", "PCB allocation failed\n");
+        return NULL; // Out of PCBs
+    }
 
-    if (process_count >= 10)
+    uint32_t pid = process_allocate_pid();
+    if (pid == 0)
     {
-        vga_print("DEBUG: Too many processes\n");
+        LOG_WARN("proc", "No free PIDs\n");
+        process_free_pcb(process);
         return NULL; // Too many processes
     }
+    process->pid = pid; // Released with the PCB from here on
+
+    if (!process_attach_directory(process))
+    {
+        LOG_WARN("proc", "Page directory allocation failed\n");
+        process_free_pcb(process);
+        return NULL; // Out of frames for the address space
+    }
 
-    vga_print("DEBUG: Getting process slot\n");
-    process_t *process = &static_processes[process_count];
+    LOG_TRACE("proc", "Allocating stack\n");
+    // Demand-paged stack in the process's own address space, heap otherwise
+    uint32_t stack_top;
+    if (process_has_address_space(process))
+    {
+        stack_top = process_map_stack(process);
+    }
+    else
+    {
+        uint32_t stack = stack_pool_get(kernel_stack_pool);
+        stack_top = stack ? stack + kernel_stack_pool->stack_size : 0;
+        process->stack_base = stack;
+        process->stack_size = kernel_stack_pool->stack_size;
+    }
 
-    vga_print("DEBUG: Allocating stack\n");
-    // Allocate real stack memory
-    void *stack = kmalloc(STACK_SIZE);
-    if (!stack)
+    if (!stack_top)
     {
-        vga_print("DEBUG: Stack allocation failed\n");
+        LOG_WARN("proc", "Stack allocation failed\n");
+        process_release_directory(process);
+        process_free_pcb(process);
         return NULL; // Out of memory for stack
     }
 
-    vga_print("DEBUG: Setting basic fields\n");
+    LOG_TRACE("proc", "Setting basic fields\n");
     // Initialize process with real memory management
-    process->pid = process_count + 1;
+    process->pid = pid;
     process->parent_pid = 0;
     process->priority = priority;
     process->state = PROCESS_READY;
 
-    vga_print("DEBUG: Copying name\n");
+    LOG_TRACE("proc", "Copying name\n");
     // Copy name safely with strict bounds checking to prevent infinite loops
     int i;
     for (i = 0; i < 63 && name && name[i] != '\0'; i++)
     {
         process->name[i] = name[i];
     }
-    vga_print("DEBUG: Name copied\n");
+    process->name[i] = '\0';
+    LOG_TRACE("proc", "Name copied\n");
 
-    vga_print("DEBUG: Setting up CPU state\n");
+    LOG_TRACE("proc", "Setting up CPU state\n");
     // Initialize CPU state with real stack BUT DON'T EXECUTE
     process->cpu_state.eip = (uint32_t)entry_point;
-    process->cpu_state.esp = (uint32_t)stack + STACK_SIZE - 4; // Stack grows down
-    process->cpu_state.eflags = 0x202;                         // Enable interrupts flag
-    process->cpu_state.cs = 0x08;                              // Kernel code segment
-    process->cpu_state.ds = 0x10;                              // Kernel data segment
+    process->cpu_state.esp = stack_top - 4; // Stack grows down
+    process->cpu_state.eflags = 0x202;      // Enable interrupts flag
+    process->cpu_state.cs = 0x08;           // Kernel code segment
+    process->cpu_state.ds = 0x10;           // Kernel data segment
     process->cpu_state.es = 0x10;
     process->cpu_state.fs = 0x10;
     process->cpu_state.gs = 0x10;
     process->cpu_state.ss = 0x10; // Kernel stack segment
 
-    vga_print("DEBUG: Setting up memory management\n");
-    // Set up memory management
-    process->stack_base = (uint32_t)stack;
-    process->stack_size = STACK_SIZE;
-    process->heap_base = 0; // No heap allocated initially
+    LOG_TRACE("proc", "Setting up memory management\n");
+    // Set up memory management: an empty heap, grown with brk/sbrk
+    process->heap_base = process_has_address_space(process) ? PROCESS_HEAP_BASE : 0;
     process->heap_size = 0;
 
-    vga_print("DEBUG: Setting up scheduling info\n");
+    LOG_TRACE("proc", "Setting up scheduling info\n");
     // Initialize scheduling info
     process->time_slice = DEFAULT_TIME_SLICE;
+    process->sched_level = MLFQ_BASE_LEVEL(priority);
+    process->quantum_left = process->time_slice;
     process->total_runtime = 0;
     process->sleep_until = 0;
+    ktimer_init(&process->sleep_timer, process_sleep_expired, process);
 
-    vga_print("DEBUG: Clearing pointers\n");
+    LOG_TRACE("proc", "Clearing pointers\n");
     // Clear pointers
     process->next = NULL;
     process->prev = NULL;
@@ -126,24 +325,17 @@ process_t *process_create(const char *name, void *entry_point, process_priority_
     process->children = NULL;
     process->next_child = NULL;
 
-    vga_print("DEBUG: Clearing file descriptors\n");
+    LOG_TRACE("proc", "Clearing file descriptors\n");
     // Clear file descriptors
     for (int j = 0; j < 16; j++)
     {
         process->file_descriptors[j] = NULL;
     }
 
-    vga_print("DEBUG: Adding to process table\n");
-    // Add to process table using PID as index
-    if (process->pid < MAX_PROCESSES)
-    {
-        process_table[process->pid] = process;
-    }
-
-    vga_print("DEBUG: Incrementing process count\n");
-    process_count++;
+    LOG_TRACE("proc", "Adding to process table\n");
+    process_register(process);
 
-    vga_print("DEBUG: process_create completed successfully\n");
+    LOG_DEBUG("proc", "process_create completed successfully\n");
 
     // IMPORTANT: Do NOT execute the entry_point function!
     // Just store it for potential future execution
@@ -152,6 +344,54 @@ process_t *process_create(const char *name, void *entry_point, process_priority_
     return process;
 }
 
+/**
+ * Allocate a PCB with a PID, a name and fresh scheduling state, but no
+ * memory of its own. The caller sets up the stack and entry point, then
+ * publishes it with process_start(), or gives it back with
+ * process_free_pcb().
+ */
+process_t *process_alloc(const char *name, process_priority_t priority)
+{
+    process_t *process = slab_alloc(process_cache);
+    if (!process)
+        return NULL;
+
+    uint32_t pid = process_allocate_pid();
+    if (pid == 0)
+    {
+        process_free_pcb(process);
+        return NULL;
+    }
+
+    // The constructor left everything else zeroed
+    process->pid = pid;
+    int i;
+    for (i = 0; i < 63 && name && name[i] != '\0'; i++)
+    {
+        process->name[i] = name[i];
+    }
+    process->name[i] = '\0';
+
+    process->priority = priority;
+    process->state = PROCESS_READY;
+    process->time_slice = DEFAULT_TIME_SLICE;
+    process->sched_level = MLFQ_BASE_LEVEL(priority);
+    process->quantum_left = process->time_slice;
+    ktimer_init(&process->sleep_timer, process_sleep_expired, process);
+    return process;
+}
+
+/**
+ * Enter a process from process_alloc() in the process table, as a child
+ * of the current process, and make it runnable
+ */
+void process_start(process_t *process)
+{
+    process->parent = current_process;
+    process_register(process);
+    add_to_ready_queue(process);
+}
+
 /**
  * Destroy a process and free its resources
  */
@@ -163,78 +403,221 @@ void process_destroy(process_t *process)
     // Remove from ready queue
     remove_from_ready_queue(process);
 
-    // Free stack memory
-    if (process->stack_base)
+    // Free stack memory and the address space (stack and heap pages included)
+    process_release_stack(process);
+    process_release_directory(process);
+
+    // The heap lives in the address space and went with it
+
+    // Remove from process table
+    process_unregister(process);
+
+    // Free PCB
+    process_free_pcb(process);
+}
+
+/**
+ * Turn a process into a zombie: it stops running and gives back its
+ * memory, keeping only the PCB with its exit code until the parent reaps
+ * it with wait. A process without a parent is freed right away. The
+ * stack of the running process is still in use, so it goes at reap time.
+ */
+void process_terminate(process_t *process, int exit_code)
+{
+    if (!process || process->state == PROCESS_TERMINATED)
+        return;
+
+    uint32_t flags = irq_save();
+
+    remove_from_ready_queue(process);
+    edf_release(process); // Its bandwidth is free for others at once
+    ktimer_cancel(&process->sleep_timer);
+    wait_queue_remove(process);
+    process->exit_code = exit_code;
+    process->state = PROCESS_TERMINATED;
+
+    if (process != current_process)
     {
-        kfree((void *)process->stack_base);
+        process_release_stack(process);
+        process_release_directory(process);
+        fpu_release(process);
     }
 
-    // Free heap memory (if allocated)
-    if (process->heap_base)
+    if (process->parent)
     {
-        kfree((void *)process->heap_base);
+        wait_queue_wake_all(&process->parent->child_exit);
     }
-
-    // Remove from process table
-    if (process->pid < MAX_PROCESSES)
+    else if (process != current_process)
     {
-        process_table[process->pid] = NULL;
+        process_destroy(process);
+    }
+    else
+    {
+        orphan_zombies++;
     }
 
-    // Free PCB
-    kfree(process);
+    irq_restore(flags);
 }
 
 /**
- * Exit current process - DISABLED FOR STABILITY
+ * Exit the current process. The kernel process runs the shell and
+ * ignores this (demo programs run on it through exec call it too).
  */
 void process_exit(int exit_code)
 {
-    // Process exit disabled to prevent crashes
-    // Just mark as terminated but don't actually exit
-    if (current_process && current_process != kernel_process)
+    process_t *process = current_process;
+    if (!process || process == kernel_process)
+        return;
+
+    process_terminate(process, exit_code);
+    schedule(); // Terminated processes are never picked again
+
+    while (1)
     {
-        current_process->state = PROCESS_TERMINATED;
+        asm volatile("hlt");
     }
-
-    // Don't call schedule() to avoid crashes
-    return;
 }
 
 /**
- * Allocate a unique process ID
+ * Allocate a unique process ID. Returns 0 when the process table is full.
  */
 uint32_t process_allocate_pid(void)
 {
-    // Check current position first
-    if (next_pid < MAX_PROCESSES && process_table[next_pid] == NULL)
+    if (process_count >= MAX_PROCESSES)
+        return 0;
+
+    return pid_alloc();
+}
+
+/**
+ * Find process by PID
+ */
+process_t *process_find_by_pid(uint32_t pid)
+{
+    for (process_t *process = pid_hash[pid % PID_HASH_SIZE]; process; process = process->hash_next)
     {
-        uint32_t pid = next_pid;
-        next_pid++;
-        return pid;
+        if (process->pid == pid)
+            return process;
     }
+    return NULL;
+}
 
-    // Simple PID allocation - find first free PID
-    for (uint32_t pid = 1; pid < MAX_PROCESSES; pid++)
+/**
+ * Add a process to its parent's children
+ */
+static void process_link_child(process_t *parent, process_t *child)
+{
+    child->parent = parent;
+    child->parent_pid = parent->pid;
+    child->next_child = parent->children;
+    parent->children = child;
+}
+
+/**
+ * Enter a fully set up process in the PID table, the live-process list
+ * and its parent's children
+ */
+static void process_register(process_t *process)
+{
+    process_t **bucket = &pid_hash[process->pid % PID_HASH_SIZE];
+    process->hash_next = *bucket;
+    *bucket = process;
+
+    process->list_next = NULL;
+    process->list_prev = process_list_tail;
+    if (process_list_tail)
+        process_list_tail->list_next = process;
+    else
+        process_list = process;
+    process_list_tail = process;
+    process_count++;
+
+    if (process->parent)
+    {
+        process_link_child(process->parent, process);
+    }
+}
+
+/**
+ * Undo process_register. Children are orphaned, not reaped.
+ */
+static void process_unregister(process_t *process)
+{
+    if (!process->list_prev && process_list != process)
+        return; // Never registered
+
+    for (process_t **link = &pid_hash[process->pid % PID_HASH_SIZE]; *link; link = &(*link)->hash_next)
     {
-        if (process_table[pid] == NULL)
+        if (*link == process)
         {
-            next_pid = pid + 1;
-            return pid;
+            *link = process->hash_next;
+            break;
         }
     }
+    process->hash_next = NULL;
 
-    return 0; // No free PIDs
+    if (process->list_prev)
+        process->list_prev->list_next = process->list_next;
+    else
+        process_list = process->list_next;
+    if (process->list_next)
+        process->list_next->list_prev = process->list_prev;
+    else
+        process_list_tail = process->list_prev;
+    process->list_next = NULL;
+    process->list_prev = NULL;
+    process_count--;
+
+    if (process->parent)
+    {
+        for (process_t **link = &process->parent->children; *link; link = &(*link)->next_child)
+        {
+            if (*link == process)
+            {
+                *link = process->next_child;
+                break;
+            }
+        }
+        process->parent = NULL;
+        process->next_child = NULL;
+    }
+
+    while (process->children)
+    {
+        process_t *child = process->children;
+        process->children = child->next_child;
+        child->parent = NULL;
+        child->next_child = NULL;
+
+        // Nobody is left to wait for an exited child
+        if (child->state == PROCESS_TERMINATED)
+        {
+            orphan_zombies++;
+        }
+    }
 }
 
 /**
- * Find process by PID
+ * Free one exited process that has no parent to reap it. Returns false
+ * if there was none.
  */
-process_t *process_find_by_pid(uint32_t pid)
+static bool process_reap_orphan(void)
 {
-    if (pid >= MAX_PROCESSES)
-        return NULL;
-    return process_table[pid];
+    if (!orphan_zombies)
+        return false;
+
+    for (process_t *process = process_list; process; process = process->list_next)
+    {
+        if (process->state == PROCESS_TERMINATED && !process->parent && process != current_process)
+        {
+            orphan_zombies--;
+            process_cleanup(process);
+            return true;
+        }
+    }
+
+    orphan_zombies = 0; // All gone some other way
+    return false;
 }
 
 /**
@@ -266,29 +649,14 @@ int process_kill_by_pid(uint32_t pid)
         return PROCESS_PROTECTED; // Cannot kill current kernel process
     }
 
-    // Clean up allocated memory
-    if (process->stack_base)
-    {
-        kfree((void *)process->stack_base);
-        process->stack_base = 0;
-        process->stack_size = 0;
-    }
-
-    if (process->heap_base)
+    // The shell keeps running as the kernel process once its target is gone
+    if (process == current_process)
     {
-        kfree((void *)process->heap_base);
-        process->heap_base = 0;
-        process->heap_size = 0;
+        current_process = kernel_process;
     }
 
-    // Mark as terminated
-    process->state = PROCESS_TERMINATED;
-
-    // Remove from process table
-    if (pid < MAX_PROCESSES)
-    {
-        process_table[pid] = NULL;
-    }
+    // Free its memory now; the PCB stays as a zombie if a parent will wait
+    process_terminate(process, PROCESS_EXIT_KILLED);
 
     return PROCESS_SUCCESS; // Success
 }
@@ -324,15 +692,7 @@ void process_print_info(process_t *process)
 
     vga_print("Process Info:\n");
     vga_print("  PID: ");
-    if (process->pid < 10)
-    {
-        vga_putchar('0' + process->pid);
-    }
-    else
-    {
-        vga_putchar('0' + (process->pid / 10));
-        vga_putchar('0' + (process->pid % 10));
-    }
+    vga_print_dec(process->pid);
     vga_print("\n");
 
     vga_print("  Name: ");
@@ -378,16 +738,7 @@ void process_print_info(process_t *process)
         }
         vga_print(" (");
         // Show stack size in KB
-        uint32_t kb = process->stack_size / 1024;
-        if (kb < 10)
-        {
-            vga_putchar('0' + kb);
-        }
-        else
-        {
-            vga_putchar('0' + (kb / 10));
-            vga_putchar('0' + (kb % 10));
-        }
+        vga_print_dec(process->stack_size / 1024);
         vga_print("KB)");
     }
     else
@@ -396,6 +747,51 @@ void process_print_info(process_t *process)
     }
     vga_print("\n");
 
+    if (process->heap_base)
+    {
+        vga_print("  Heap: ");
+        vga_print_hex(process->heap_base);
+        vga_print(" - ");
+        vga_print_hex(process->heap_base + process->heap_size);
+        vga_print(" (");
+        vga_print_dec(process->memory_used / 1024);
+        vga_print("KB resident)\n");
+    }
+
+    vga_print("  Scheduling: level ");
+    vga_print_dec(process->sched_level);
+    vga_print(", ");
+    vga_print_dec(process->quantum_left);
+    vga_print(" ticks of quantum left\n");
+
+    if (process->fpu_state)
+    {
+        vga_print(process == fpu_owner ? "  FPU: live in registers\n" : "  FPU: saved\n");
+    }
+
+    if (process->cow_shared_pages)
+    {
+        vga_print("  Copy-on-write: ");
+        vga_print_dec(process->cow_copied_pages);
+        vga_print(" of ");
+        vga_print_dec(process->cow_shared_pages);
+        vga_print(" shared pages copied\n");
+    }
+
+    vga_print("  CPU: ");
+    vga_print_dec((uint32_t)(scheduler_cpu_cycles(process) / 1000));
+    vga_print("K cycles (");
+    vga_print_dec(process->total_runtime);
+    vga_print(" ticks), IRQ ");
+    vga_print_dec((uint32_t)(process->irq_cycles / 1000));
+    vga_print("K, run-queue wait ");
+    vga_print_dec((uint32_t)(process->wait_cycles / 1000));
+    vga_print("K\n  Switches: ");
+    vga_print_dec(process->voluntary_switches);
+    vga_print(" voluntary, ");
+    vga_print_dec(process->involuntary_switches);
+    vga_print(" involuntary\n");
+
     vga_print("  Entry Point: 0x");
     uint32_t eip = process->cpu_state.eip;
     for (int i = 28; i >= 0; i -= 4)
@@ -419,87 +815,63 @@ void process_print_info(process_t *process)
 void process_list_all(void)
 {
     vga_print("Process List:\n");
-    vga_print("PID\tNAME\t\tSTATE\t\tMEMORY\n");
-    vga_print("---\t----\t\t-----\t\t------\n");
+    vga_print("PID\tNAME\t\tSTATE\t\tMEMORY\tCPU\n");
+    vga_print("---\t----\t\t-----\t\t------\t---\n");
 
     int found_processes = 0;
-    for (int i = 0; i < MAX_PROCESSES; i++)
+    for (process_t *proc = process_list; proc; proc = proc->list_next)
     {
-        if (process_table[i])
-        {
-            found_processes++;
-            process_t *proc = process_table[i];
+        found_processes++;
 
-            // Print PID
-            if (proc->pid < 10)
-            {
-                vga_putchar('0' + proc->pid);
-            }
-            else
-            {
-                vga_putchar('0' + (proc->pid / 10));
-                vga_putchar('0' + (proc->pid % 10));
-            }
-            vga_print("\t");
+        // Print PID
+        vga_print_dec(proc->pid);
+        vga_print("\t");
 
-            // Print name (truncate if too long)
-            int name_len = 0;
-            while (proc->name[name_len] && name_len < 12)
-            {
-                vga_putchar(proc->name[name_len]);
-                name_len++;
-            }
+        // Print name (truncate if too long)
+        int name_len = 0;
+        while (proc->name[name_len] && name_len < 12)
+        {
+            vga_putchar(proc->name[name_len]);
+            name_len++;
+        }
 
-            // Pad name to align columns
-            while (name_len < 12)
-            {
-                vga_putchar(' ');
-                name_len++;
-            }
-            vga_print("\t");
+        // Pad name to align columns
+        while (name_len < 12)
+        {
+            vga_putchar(' ');
+            name_len++;
+        }
+        vga_print("\t");
 
-            // Print state
-            switch (proc->state)
-            {
-            case PROCESS_READY:
-                vga_print("READY\t\t");
-                break;
-            case PROCESS_RUNNING:
-                vga_print("RUNNING\t\t");
-                break;
-            case PROCESS_BLOCKED:
-                vga_print("BLOCKED\t\t");
-                break;
-            case PROCESS_TERMINATED:
-                vga_print("TERMINATED\t");
-                break;
-            default:
-                vga_print("UNKNOWN\t\t");
-                break;
-            }
+        // Print state
+        switch (proc->state)
+        {
+        case PROCESS_READY:
+            vga_print("READY\t\t");
+            break;
+        case PROCESS_RUNNING:
+            vga_print("RUNNING\t\t");
+            break;
+        case PROCESS_BLOCKED:
+            vga_print("BLOCKED\t\t");
+            break;
+        case PROCESS_TERMINATED:
+            vga_print("TERMINATED\t");
+            break;
+        default:
+            vga_print("UNKNOWN\t\t");
+            break;
+        }
 
-            // Print memory usage
-            if (proc->stack_base)
-            {
-                uint32_t kb = proc->stack_size / 1024;
-                if (kb < 10)
-                {
-                    vga_putchar('0' + kb);
-                }
-                else
-                {
-                    vga_putchar('0' + (kb / 10));
-                    vga_putchar('0' + (kb % 10));
-                }
-                vga_print("KB");
-            }
-            else
-            {
-                vga_print("0KB");
-            }
+        // Print memory usage
+        vga_print_dec(proc->stack_base ? proc->stack_size / 1024 : 0);
+        vga_print("KB");
 
-            vga_print("\n");
-        }
+        // CPU time in timer ticks; 'top' has cycle-accurate figures
+        vga_print("\t");
+        vga_print_dec(proc->total_runtime);
+
+        vga_print("\n");
     }
 
     if (found_processes == 0)
@@ -509,188 +881,143 @@ void process_list_all(void)
 }
 
 /**
- * Add process to ready queue
+ * One unit of background work: reap an orphaned zombie, top up the
+ * pre-zeroed frame pool, then pre-zero free heap blocks. Returns false
+ * when there is nothing to do.
  */
-void add_to_ready_queue(process_t *process)
+bool process_idle_work(void)
 {
-    if (!process || process->state != PROCESS_READY)
-        return;
-
-    process->next = NULL;
-    process->prev = ready_queue_tail;
+    return process_reap_orphan() || pmm_prezero_step() || heap_prezero_step();
+}
 
-    if (ready_queue_tail)
-    {
-        ready_queue_tail->next = process;
-    }
-    else
+/**
+ * Kernel idle task - runs when no other processes are ready
+ */
+static void process_idle_task(void)
+{
+    while (1)
     {
-        ready_queue_head = process;
+        // Spend idle time zeroing memory; halt once there is nothing left
+        if (!process_idle_work())
+        {
+            timer_idle(TIMER_NO_DEADLINE);
+        }
     }
-
-    ready_queue_tail = process;
 }
 
 /**
- * Remove process from ready queue
+ * Block a process for `ticks` timer ticks. Its wake-up is a timer on the
+ * timing wheel; a sleeping current process gives up the CPU until then.
  */
-void remove_from_ready_queue(process_t *process)
+void process_sleep(process_t *process, uint32_t ticks)
 {
-    if (!process)
+    if (!process || process->state == PROCESS_TERMINATED)
         return;
 
-    if (process->prev)
-    {
-        process->prev->next = process->next;
-    }
-    else
-    {
-        ready_queue_head = process->next;
-    }
+    uint32_t flags = irq_save();
 
-    if (process->next)
-    {
-        process->next->prev = process->prev;
-    }
-    else
+    remove_from_ready_queue(process);
+    process->state = PROCESS_BLOCKED;
+    process->sleep_until = timer_get_ticks() + ticks;
+    ktimer_add(&process->sleep_timer, process->sleep_until);
+
+    if (process == current_process)
     {
-        ready_queue_tail = process->prev;
+        scheduler_block();
     }
 
-    process->next = NULL;
-    process->prev = NULL;
+    irq_restore(flags);
 }
 
 /**
- * Round-robin scheduler with context switching
+ * Make a blocked process runnable again, cancelling any pending sleep
  */
-void schedule(void)
+void process_wake(process_t *process)
 {
-    if (!ready_queue_head)
-    {
-        // No processes ready, switch to idle if needed
-        if (current_process != kernel_process)
-        {
-            context_switch(current_process, kernel_process);
-            current_process = kernel_process;
-        }
-        return;
-    }
-
-    // Get next process from ready queue
-    process_t *next_process = ready_queue_head;
-
-    // If current process is still running and in ready queue, move to back
-    if (current_process && current_process->state == PROCESS_RUNNING)
-    {
-        current_process->state = PROCESS_READY;
-        // Move current process to end of queue if it's not already there
-        if (current_process != ready_queue_tail)
-        {
-            remove_from_ready_queue(current_process);
-            add_to_ready_queue(current_process);
-        }
-    }
-
-    // If next process is the same as current, no switch needed
-    if (next_process == current_process)
-    {
+    if (!process || process->state != PROCESS_BLOCKED)
         return;
-    }
 
-    // Remove next process from ready queue and mark as running
-    remove_from_ready_queue(next_process);
-    next_process->state = PROCESS_RUNNING;
+    uint32_t flags = irq_save();
 
-    // Perform context switch
-    process_t *old_process = current_process;
-    current_process = next_process;
+    ktimer_cancel(&process->sleep_timer);
+    process->sleep_until = 0;
 
-    if (old_process)
+    if (process == current_process)
     {
-        context_switch(old_process, next_process);
+        // Blocked in scheduler_block() with nothing else to run
+        process->state = PROCESS_RUNNING;
     }
     else
     {
-        switch_to_process(next_process);
+        process->state = PROCESS_READY;
+        add_to_ready_queue(process);
     }
-}
 
-/**
- * Scheduler tick - called by timer interrupt
- */
-void scheduler_tick(void)
-{
-    // Simple time-slice scheduling - switch every tick
-    schedule();
+    irq_restore(flags);
 }
 
 /**
- * Get next process for scheduling
+ * Sleep timer callback (timer interrupt context)
  */
-process_t *scheduler_get_next(void)
+static void process_sleep_expired(void *data)
 {
-    return ready_queue_head;
+    process_wake((process_t *)data);
 }
 
-/**
- * Get current running process
- */
-process_t *scheduler_get_current(void)
+// Simple test function with same signature - SAFE VERSION WITHOUT KMALLOC
+process_t *process_create_test(const char *name, void *entry_point, process_priority_t priority)
 {
-    return current_process;
-}
+    LOG_DEBUG("proc", "Creating process without kmalloc\n");
 
-/**
- * Kernel idle task - runs when no other processes are ready
- */
-static void process_idle_task(void)
-{
-    while (1)
+    // PCB from the process cache, stack demand-paged or from the kernel stack pool
+    process_t *process = slab_alloc(process_cache);
+    if (!process)
     {
-        // Idle loop - just busy wait instead of halt for now
-        // asm volatile("hlt");  // Don't halt since we don't have timer interrupts
-        for (volatile int i = 0; i < 1000000; i++)
-        {
-            // Busy wait to prevent kernel from exiting
-        }
+        LOG_WARN("proc", "Out of PCBs\n");
+        return NULL;
     }
-}
 
-/**
- * Initialize scheduler
- */
-void scheduler_init(void)
-{
-    vga_print("  Initializing scheduler...\n");
-    ready_queue_head = NULL;
-    ready_queue_tail = NULL;
-    vga_print("  Scheduler ready\n");
-}
-
-// Simple test function with same signature - SAFE VERSION WITHOUT KMALLOC
-process_t *process_create_test(const char *name, void *entry_point, process_priority_t priority)
-{
-    vga_print("Creating process without kmalloc...\n");
+    uint32_t pid = process_allocate_pid();
+    if (pid == 0)
+    {
+        LOG_WARN("proc", "Too many processes\n");
+        process_free_pcb(process);
+        return NULL; // Too many processes
+    }
+    process->pid = pid; // Released with the PCB from here on
 
-    // Use hybrid approach: static PCBs + static stack arrays (no kmalloc)
-    static process_t static_processes[10];
-    static char static_stacks[10][4096]; // 4KB stacks for each process
-    static int process_count = 0;
+    if (!process_attach_directory(process))
+    {
+        LOG_WARN("proc", "Out of memory for page directory\n");
+        process_free_pcb(process);
+        return NULL;
+    }
 
-    if (process_count >= 10)
+    uint32_t stack_top = 0;
+    if (process_has_address_space(process))
     {
-        vga_print("ERROR: Too many processes\n");
-        return NULL; // Too many processes
+        stack_top = process_map_stack(process);
+    }
+    else
+    {
+        uint32_t stack = stack_pool_get(kernel_stack_pool);
+        stack_top = stack ? stack + kernel_stack_pool->stack_size : 0;
+        process->stack_base = stack;
+        process->stack_size = kernel_stack_pool->stack_size;
     }
 
-    process_t *process = &static_processes[process_count];
-    char *stack = static_stacks[process_count];
+    if (!stack_top)
+    {
+        LOG_WARN("proc", "No memory for process stack\n");
+        process_release_directory(process);
+        process_free_pcb(process);
+        return NULL;
+    }
 
-    vga_print("Initializing process data...\n");
+    LOG_TRACE("proc", "Initializing process data\n");
 
-    // Initialize process with static memory management
-    process->pid = process_count + 1;
+    // Initialize process data
+    process->pid = pid;
     process->parent_pid = 0;
     process->priority = priority;
     process->state = PROCESS_READY;
@@ -703,29 +1030,30 @@ process_t *process_create_test(const char *name, void *entry_point, process_prio
     }
     process->name[i] = '\0';
 
-    vga_print("Setting up CPU state...\n");
+    LOG_TRACE("proc", "Setting up CPU state\n");
 
-    // Initialize CPU state with static stack
+    // Initialize CPU state
     process->cpu_state.eip = (uint32_t)entry_point;
-    process->cpu_state.esp = (uint32_t)stack + 4096 - 4; // Stack grows down
-    process->cpu_state.eflags = 0x202;                   // Enable interrupts flag
-    process->cpu_state.cs = 0x08;                        // Kernel code segment
-    process->cpu_state.ds = 0x10;                        // Kernel data segment
+    process->cpu_state.esp = stack_top - 4; // Stack grows down
+    process->cpu_state.eflags = 0x202;      // Enable interrupts flag
+    process->cpu_state.cs = 0x08;           // Kernel code segment
+    process->cpu_state.ds = 0x10;           // Kernel data segment
     process->cpu_state.es = 0x10;
     process->cpu_state.fs = 0x10;
     process->cpu_state.gs = 0x10;
     process->cpu_state.ss = 0x10; // Kernel stack segment
 
-    // Set up memory management
-    process->stack_base = (uint32_t)stack;
-    process->stack_size = 4096;
-    process->heap_base = 0; // No heap allocated initially
+    // Set up memory management: an empty heap, grown with brk/sbrk
+    process->heap_base = process_has_address_space(process) ? PROCESS_HEAP_BASE : 0;
     process->heap_size = 0;
 
     // Initialize scheduling info
     process->time_slice = DEFAULT_TIME_SLICE;
+    process->sched_level = MLFQ_BASE_LEVEL(priority);
+    process->quantum_left = process->time_slice;
     process->total_runtime = 0;
     process->sleep_until = 0;
+    ktimer_init(&process->sleep_timer, process_sleep_expired, process);
 
     // Clear pointers
     process->next = NULL;
@@ -740,46 +1068,208 @@ process_t *process_create_test(const char *name, void *entry_point, process_prio
         process->file_descriptors[j] = NULL;
     }
 
-    // Add to process table using PID as index
-    if (process->pid < MAX_PROCESSES)
+    process_register(process);
+
+    LOG_DEBUG("proc", "Process created with a pooled stack\n");
+
+    return process;
+}
+
+/**
+ * Find the process running in a page directory
+ */
+static process_t *process_find_by_directory(uint32_t *directory)
+{
+    for (process_t *process = process_list; process; process = process->list_next)
     {
-        process_table[process->pid] = process;
+        if (process->page_directory == directory)
+        {
+            return process;
+        }
     }
+    return NULL;
+}
 
-    process_count++;
+/**
+ * Resolve a fault in a process address space: a write to a copy-on-write
+ * page, or a not-present page in a demand-paged region (the stack reserve
+ * above its guard page, or the heap below the current break).
+ * Returns false if the fault is a real error.
+ */
+bool process_handle_page_fault(uint32_t *directory, uint32_t fault_addr, uint32_t error_code)
+{
+    if (!directory || directory == vmm_kernel_directory())
+        return false;
 
-    vga_print("Process created successfully with static memory!\n");
+    process_t *process = process_find_by_directory(directory);
+    if (!process)
+        return false;
 
-    return process;
+    // Write to a page shared with a forked relative
+    if (error_code & PAGE_FAULT_PRESENT)
+    {
+        if (!(error_code & PAGE_FAULT_WRITE))
+            return false;
+
+        int result = vmm_handle_cow_fault(directory, fault_addr);
+        if (result == VMM_COW_COPIED)
+        {
+            process->cow_copied_pages++;
+        }
+        return result != VMM_COW_NONE;
+    }
+
+    uint32_t page = fault_addr & ~(PAGE_SIZE - 1);
+    uint32_t guard_page = PROCESS_STACK_TOP - PROCESS_STACK_RESERVE;
+
+    if (page == guard_page)
+    {
+        vga_print("\nStack overflow in process ");
+        vga_print(process->name);
+        return false;
+    }
+
+    if (page > guard_page && page < PROCESS_STACK_TOP)
+    {
+        if (!process_map_zeroed_page(directory, page))
+            return false;
+        process->stack_size += PAGE_SIZE;
+        process->memory_used += PAGE_SIZE;
+        return true;
+    }
+
+    if (process->heap_base >= PROCESS_HEAP_BASE && fault_addr >= process->heap_base &&
+        fault_addr < process->heap_base + process->heap_size)
+    {
+        if (!process_map_zeroed_page(directory, page))
+            return false;
+        process->memory_used += PAGE_SIZE;
+        return true;
+    }
+
+    return false;
 }
 
 /**
- * Create a copy of an existing process (for fork)
+ * Move the heap break of a process. Growing only reserves address space;
+ * the pages are faulted in on first touch. Shrinking unmaps and releases
+ * every page wholly above the new break.
+ * Returns false if the break would leave [heap_base, PROCESS_HEAP_LIMIT].
+ */
+bool process_set_break(process_t *process, uint32_t new_break)
+{
+    if (!process || !process_has_address_space(process))
+        return false; // No private heap region
+
+    if (new_break < process->heap_base || new_break > PROCESS_HEAP_LIMIT)
+        return false;
+
+    uint32_t old_break = process->heap_base + process->heap_size;
+    uint32_t first_unused = (new_break + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    for (uint32_t page = first_unused; page < old_break; page += PAGE_SIZE)
+    {
+        uint32_t frame = vmm_unmap_page(process->page_directory, page);
+        if (frame)
+        {
+            pmm_frame_put(frame); // May still be shared with a forked relative
+            process->memory_used -= PAGE_SIZE;
+        }
+    }
+
+    process->heap_size = new_break - process->heap_base;
+    return true;
+}
+
+/**
+ * Clone the current process's address space for a child; called by
+ * fork_context() with the child's resume frame on the stack
+ */
+static uint32_t process_clone_space(process_t *child)
+{
+    child->page_directory = vmm_clone_directory(current_process->page_directory, &child->cow_shared_pages);
+    return child->page_directory != NULL;
+}
+
+/**
+ * Create a copy of the current process (for fork). Both processes return
+ * from here with the child's PCB: the parent once the child is set up,
+ * and later the child itself, when it first runs, on its copy-on-write
+ * copy of the stack. Returns NULL on failure, or if the process has no
+ * address space of its own (the kernel process and kernel threads run on
+ * stacks that cannot be copied for a child).
  */
 process_t *process_create_copy(process_t *parent)
 {
-    if (!parent)
+    if (!parent || parent != current_process || !process_has_address_space(parent))
     {
         return NULL;
     }
 
-    // Create new process with same entry point and priority
-    process_t *child = process_create_test(parent->name, (void *)parent->cpu_state.eip, parent->priority);
+    // The slab, PID map, frame reference counts and process list are all
+    // shared with the timer interrupt's wakeups and exits
+    uint32_t flags = irq_save();
+
+    process_t *child = slab_alloc(process_cache);
     if (!child)
     {
+        irq_restore(flags);
         return NULL;
     }
 
-    // Copy CPU state from parent
-    child->cpu_state = parent->cpu_state;
+    uint32_t pid = process_allocate_pid();
+    if (pid == 0)
+    {
+        process_free_pcb(child);
+        irq_restore(flags);
+        return NULL;
+    }
+    child->pid = pid;
+
+    // Share every page copy-on-write, the stack included, with a frame on
+    // it that the child resumes from: it returns 0 from fork_context()
+    if (!fork_context(child, process_clone_space))
+    {
+        // The child comes out of context_switch with interrupts off; the
+        // saved flags give it the parent's interrupt state back
+        bool is_child = current_process == child;
+        if (!is_child)
+            process_free_pcb(child);
+
+        irq_restore(flags);
+        return is_child ? child : NULL;
+    }
 
-    // Set return value for child (fork returns 0 to child)
-    child->cpu_state.eax = 0;
+    child->pid = pid;
+    child->parent_pid = parent->pid;
+    child->parent = parent;
+    child->priority = parent->priority;
+    child->state = PROCESS_READY;
+    memcpy(child->name, parent->name, sizeof(child->name));
 
-    // Copy memory contents (simplified - in real OS would copy entire address space)
-    // For now, just copy some basic state
+    // Same memory layout as the parent; cpu_state is only for display, as
+    // the child starts from its saved kernel_esp
+    child->cpu_state = parent->cpu_state;
+    child->stack_base = parent->stack_base;
+    child->stack_size = parent->stack_size;
+    child->heap_base = parent->heap_base;
+    child->heap_size = parent->heap_size;
     child->memory_used = parent->memory_used;
+    child->time_slice = DEFAULT_TIME_SLICE;
+    child->sched_level = parent->sched_level;
+    child->quantum_left = child->time_slice;
+    ktimer_init(&child->sleep_timer, process_sleep_expired, child);
 
+    if (!fpu_copy(child, parent))
+    {
+        process_release_directory(child);
+        process_free_pcb(child);
+        irq_restore(flags);
+        return NULL;
+    }
+
+    process_register(child);
+    irq_restore(flags);
     return child;
 }
 
@@ -794,16 +1284,15 @@ void process_cleanup(process_t *process)
     }
 
     // Remove from process table
-    if (process->pid < MAX_PROCESSES)
-    {
-        process_table[process->pid] = NULL;
-    }
+    process_unregister(process);
 
     // Remove from ready queue if present
     remove_from_ready_queue(process);
 
-    // Mark as free (in static allocation, just clear the structure)
-    memset(process, 0, sizeof(process_t));
+    // Release the stack and address space, then return the PCB to its cache
+    process_release_stack(process);
+    process_release_directory(process);
+    process_free_pcb(process);
 }
 
 /**
@@ -813,14 +1302,17 @@ void enable_process_execution(void)
 {
     vga_print("Enabling real process execution with context switching!\n");
 
-    // Create kernel idle process
+    // Create kernel idle process. It is also the shell, so it gets an
+    // interactive base level; it sleeps between keyboard polls rather than
+    // yielding, so it never holds the CPU from lower levels
     if (!kernel_process)
     {
-        kernel_process = process_create_test("kernel_idle", (void *)process_idle_task, PRIORITY_LOW);
+        kernel_process = process_create_test("kernel_idle", (void *)process_idle_task, PRIORITY_HIGH);
         if (kernel_process)
         {
             kernel_process->state = PROCESS_RUNNING;
             current_process = kernel_process;
+            fpu_switch(kernel_process); // Boot code may have left TS clear
         }
     }
 
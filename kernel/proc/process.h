@@ -2,6 +2,9 @@
 #define PROCESS_H
 
 #include "kernel.h"
+#include "rbtree.h"
+#include "drivers/timer_wheel.h"
+#include "wait_queue.h"
 
 // Process states
 typedef enum
@@ -46,18 +49,47 @@ typedef struct process
 
     cpu_state_t cpu_state;    // Saved CPU state
     uint32_t *page_directory; // Virtual memory page directory
+    struct fpu_state *fpu_state; // FPU/SSE save area, allocated on first use
+    uint32_t kernel_esp;      // Stack pointer while switched out (0: never ran)
+    uint32_t flags;           // PROCESS_FLAG_*
 
     // Memory management
     uint32_t stack_base;  // Stack base address
     uint32_t stack_size;  // Stack size
-    uint32_t heap_base;   // Heap base address
-    uint32_t heap_size;   // Current heap size
-    uint32_t memory_used; // Total memory used
+    uint32_t heap_base;   // Heap base address (0: no private heap)
+    uint32_t heap_size;   // Current heap size (break = heap_base + heap_size)
+    uint32_t memory_used; // Resident stack and heap bytes
+    uint32_t cow_shared_pages; // Pages shared with the parent at fork
+    uint32_t cow_copied_pages; // Shared pages copied on write since
 
     // Scheduling information
     uint32_t time_slice;    // Time quantum for scheduling
-    uint32_t total_runtime; // Total CPU time used
+    uint32_t sched_level;   // Multilevel feedback queue level (0 runs first)
+    uint32_t quantum_left;  // Ticks left of the current quantum
+    uint32_t total_runtime; // Total CPU time used (timer ticks)
+
+    // CPU accounting in TSC cycles, charged at every switch. Everything
+    // runs in ring 0, so there is no separate user time.
+    uint64_t cpu_cycles;           // On the CPU, less interrupts and halts
+    uint64_t irq_cycles;           // Timer interrupt work while it ran
+    uint64_t wait_cycles;          // Runnable, waiting in the run queue
+    uint64_t account_since;        // Start of the current run or wait
+    uint32_t voluntary_switches;   // Gave up the CPU: yield, sleep, block
+    uint32_t involuntary_switches; // Preempted
+    uint64_t vruntime;      // CFS: weighted virtual runtime (ns)
+    rb_node_t sched_node;   // CFS: node in the vruntime tree
+    uint32_t dl_runtime;      // Deadline: ticks of CPU per period
+    uint32_t dl_deadline;     // Deadline: relative to each release
+    uint32_t dl_period;       // Deadline: ticks between releases (0: not a deadline process)
+    uint32_t dl_release;      // Deadline: release tick of the current job
+    uint32_t dl_abs_deadline; // Deadline: tick the current job is due by
+    uint32_t dl_budget;       // Deadline: ticks left for the current job
+    rb_node_t dl_node;        // Deadline: node in the deadline tree
     uint32_t sleep_until;   // Wake up time (if sleeping)
+    ktimer_t sleep_timer;   // Fires at sleep_until
+    wait_queue_t *wait_queue;  // Queue this process is blocked on, if any
+    struct process *wait_next; // Next process on that queue
+    wait_queue_t child_exit;   // Woken when a child terminates
 
     // File descriptors (for future file system)
     void *file_descriptors[16]; // File descriptor table
@@ -67,15 +99,27 @@ typedef struct process
     struct process *children;   // Linked list of child processes
     struct process *next_child; // Next sibling in children list
 
+    // Process table links
+    struct process *hash_next; // Next process in the same PID hash bucket
+    struct process *list_next; // Live-process list, oldest first
+    struct process *list_prev;
+
     // Scheduler queue pointers
     struct process *next; // Next process in scheduler queue
     struct process *prev; // Previous process in scheduler queue
 } process_t;
 
 // Process manager configuration
-#define MAX_PROCESSES 256
+#define MAX_PROCESSES 256 // Live processes at once; PIDs go up to PID_MAX
+#define PID_HASH_SIZE 256 // Buckets of the PID lookup table
 #define DEFAULT_TIME_SLICE 10 // Default time slice in timer ticks
-#define STACK_SIZE 4096       // Default stack size (4KB)
+#define STACK_SIZE 4096       // Stack size without an own address space (4KB)
+
+// Process flags
+#define PROCESS_FLAG_KTHREAD 0x1 // Kernel thread (proc/kthread.c)
+
+// Exit code of a killed process
+#define PROCESS_EXIT_KILLED -1
 
 // Process operation return codes
 #define PROCESS_SUCCESS 1
@@ -83,32 +127,36 @@ typedef struct process
 #define PROCESS_PROTECTED -1
 #define PROCESS_ERROR -2
 
-// Global process table
-extern process_t *process_table[MAX_PROCESSES];
+// Live processes, oldest first: for (p = process_list; p; p = p->list_next)
+extern process_t *process_list;
+extern uint32_t process_count;
 
 // Process management functions
 void process_init(void);
 process_t *process_create(const char *name, void *entry_point, process_priority_t priority);
 void process_destroy(process_t *process);
 void process_exit(int exit_code);
+void process_terminate(process_t *process, int exit_code);
 
 // Scheduler functions
 void scheduler_init(void);
 void schedule(void);
+void scheduler_block(void);
+int scheduler_set_deadline(uint32_t runtime, uint32_t deadline, uint32_t period);
+void scheduler_wait_period(void);
 process_t *scheduler_get_current(void);
 void scheduler_add_process(process_t *process);
 void scheduler_remove_process(process_t *process);
 
-// Context switching
-void context_switch(process_t *old_process, process_t *new_process);
-void save_cpu_state(cpu_state_t *state);
-void restore_cpu_state(cpu_state_t *state);
-
 // Process state management
 void process_set_state(process_t *process, process_state_t state);
 void process_sleep(process_t *process, uint32_t ticks);
 void process_wake(process_t *process);
 
+// Demand paging and the per-process heap
+bool process_handle_page_fault(uint32_t *directory, uint32_t fault_addr, uint32_t error_code);
+bool process_set_break(process_t *process, uint32_t new_break);
+
 // Process utilities
 process_t *process_find_by_pid(uint32_t pid);
 uint32_t process_allocate_pid(void);
@@ -118,6 +166,11 @@ process_t *process_find_by_pid(uint32_t pid);
 int process_kill_by_pid(uint32_t pid);
 int process_set_status(uint32_t pid, process_state_t status);
 
+// Building blocks for lighter process kinds (kernel threads)
+process_t *process_alloc(const char *name, process_priority_t priority);
+void process_start(process_t *process);
+void process_free_pcb(process_t *process);
+
 // Process management functions
 process_t *process_create_copy(process_t *parent);
 void process_cleanup(process_t *process);
@@ -125,17 +178,25 @@ void enable_process_execution(void);
 void remove_from_ready_queue(process_t *process);
 void add_to_ready_queue(process_t *process);
 
-// Context switching functions (implemented in assembly)
-void save_context(process_t *process);
-void restore_context(process_t *process);
+// Context switching (implemented in assembly)
 void context_switch(process_t *old_process, process_t *new_process);
-void switch_to_process(process_t *new_process);
+uint32_t fork_context(process_t *child, uint32_t (*clone)(process_t *child));
 
 // Scheduler functions
 void scheduler_tick(void);
 process_t *scheduler_get_next(void);
+void scheduler_print_stats(void);
+
+// CPU accounting (scheduler.c)
+void scheduler_idle_begin(void);
+void scheduler_idle_end(void);
+void scheduler_account_irq(uint64_t cycles);
+uint64_t scheduler_cpu_cycles(process_t *process);
+uint64_t scheduler_idle_cycles(void);
+void process_top(void);
 
 // Kernel process (idle task)
+bool process_idle_work(void);
 extern process_t *kernel_process;
 extern process_t *current_process;
 
@@ -144,5 +205,6 @@ void create_demo_processes(void);
 void demo_counter_process(void);
 void demo_calc_process(void);
 void demo_monitor_process(void);
+void demo_fork_process(void);
 
 #endif
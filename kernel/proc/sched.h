@@ -0,0 +1,54 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "process.h"
+
+// A scheduling policy. The core in scheduler.c owns current_process and
+// the context switch; a class only orders the runnable processes. The
+// running process is never queued in its class.
+typedef struct sched_class
+{
+    const char *name;
+    void (*init)(void);
+    void (*enqueue)(process_t *process, bool wakeup); // wakeup: new or woken, not preempted
+    void (*dequeue)(process_t *process);
+    process_t *(*pick_next)(void);                      // Best queued process, left queued
+    void (*set_next)(process_t *process);               // process is about to run
+    void (*put_prev)(process_t *process, bool voluntary); // process is leaving the CPU
+    bool (*tick)(process_t *process);                   // Charge a tick; true to reschedule
+    void (*print_stats)(void);
+} sched_class_t;
+
+extern const sched_class_t sched_mlfq_class;
+extern const sched_class_t sched_cfs_class;
+extern const sched_class_t sched_edf_class;
+
+// Multilevel feedback queue: priorities start two levels apart, so an
+// interactive process can rise one level and a CPU hog sink several
+#define MLFQ_LEVELS 8
+#define MLFQ_BASE_LEVEL(priority) ((uint32_t)(priority) * 2 + 1)
+#define MLFQ_RESET_TICKS 100 // Return everyone to their base level every second
+
+// Completely fair scheduling: every runnable process gets a turn within
+// the target latency, but no turn is shorter than the minimum granularity
+#define CFS_DEFAULT_LATENCY_MS 60
+#define CFS_DEFAULT_MIN_GRANULARITY_MS 10
+#define CFS_NICE_0_WEIGHT 1024
+
+extern uint32_t cfs_latency_ms;
+extern uint32_t cfs_min_granularity_ms;
+
+// Earliest deadline first: deadline processes run ahead of the class
+// chosen at boot. Densities are fixed point, EDF_BW_UNIT being the whole
+// CPU; admission keeps their sum under EDF_MAX_BANDWIDTH.
+#define EDF_BW_SHIFT 20
+#define EDF_BW_UNIT (1u << EDF_BW_SHIFT)
+#define EDF_MAX_BANDWIDTH (EDF_BW_UNIT / 20 * 19) // 95%: the rest stays with the boot class
+
+bool edf_admit(process_t *process, uint32_t runtime, uint32_t deadline, uint32_t period);
+void edf_release(process_t *process);
+void edf_wait_period(process_t *process);
+
+const sched_class_t *scheduler_class(void);
+
+#endif
@@ -0,0 +1,219 @@
+/* Completely Fair Scheduling Class
+ *
+ * Each process accumulates virtual runtime: real runtime scaled by
+ * CFS_NICE_0_WEIGHT over the weight of its priority, so heavier processes
+ * age more slowly. Runnable processes sit in a red-black tree keyed by
+ * vruntime and the leftmost (the one owed the most CPU) runs next.
+ *
+ * A turn lasts the process's weighted share of the target latency, but
+ * at least the minimum granularity; with many runnable processes the
+ * period stretches to nr_running * granularity instead. Runtime is
+ * charged in whole timer ticks.
+ *
+ * New and woken processes start no further back than half a latency
+ * behind min_vruntime, so sleeping does not bank unlimited credit.
+ */
+
+#include "sched.h"
+#include "../drivers/timer.h"
+
+#define CFS_TICK_NS (1000000000u / TIMER_FREQUENCY)
+#define CFS_MS_TO_NS(ms) ((uint64_t)(ms) * 1000000)
+
+// Tunables (sched latency / sched granularity commands)
+uint32_t cfs_latency_ms = CFS_DEFAULT_LATENCY_MS;
+uint32_t cfs_min_granularity_ms = CFS_DEFAULT_MIN_GRANULARITY_MS;
+
+// Load weights by process_priority_t: roughly nice -5, 0 and +5
+static const uint32_t cfs_priority_weight[] = {3121, 1024, 335};
+
+static rb_tree_t cfs_tree;
+static uint64_t cfs_min_vruntime = 0; // Never decreases
+static uint32_t cfs_queued_weight = 0;
+
+static inline uint32_t cfs_weight(process_t *process)
+{
+    return cfs_priority_weight[process->priority];
+}
+
+static bool cfs_less(const rb_node_t *a, const rb_node_t *b)
+{
+    return rb_entry(a, process_t, sched_node)->vruntime < rb_entry(b, process_t, sched_node)->vruntime;
+}
+
+static inline bool cfs_queued(process_t *process)
+{
+    return process->sched_node.parent || cfs_tree.root == &process->sched_node;
+}
+
+/**
+ * Advance min_vruntime towards the smallest vruntime still in play
+ */
+static void cfs_update_min_vruntime(process_t *running)
+{
+    rb_node_t *leftmost = rb_first(&cfs_tree);
+    uint64_t vruntime;
+
+    if (running && leftmost)
+    {
+        uint64_t queued = rb_entry(leftmost, process_t, sched_node)->vruntime;
+        vruntime = running->vruntime < queued ? running->vruntime : queued;
+    }
+    else if (running)
+    {
+        vruntime = running->vruntime;
+    }
+    else if (leftmost)
+    {
+        vruntime = rb_entry(leftmost, process_t, sched_node)->vruntime;
+    }
+    else
+    {
+        return;
+    }
+
+    if (vruntime > cfs_min_vruntime)
+    {
+        cfs_min_vruntime = vruntime;
+    }
+}
+
+static void cfs_init(void)
+{
+    rb_init(&cfs_tree);
+    cfs_min_vruntime = 0;
+    cfs_queued_weight = 0;
+}
+
+static void cfs_enqueue(process_t *process, bool wakeup)
+{
+    if (wakeup)
+    {
+        uint64_t credit = CFS_MS_TO_NS(cfs_latency_ms) / 2;
+        uint64_t floor = cfs_min_vruntime > credit ? cfs_min_vruntime - credit : 0;
+        if (process->vruntime < floor)
+        {
+            process->vruntime = floor;
+        }
+    }
+
+    rb_insert(&cfs_tree, &process->sched_node, cfs_less);
+    cfs_queued_weight += cfs_weight(process);
+}
+
+static void cfs_dequeue(process_t *process)
+{
+    if (!cfs_queued(process))
+        return;
+
+    rb_erase(&cfs_tree, &process->sched_node);
+    process->sched_node.parent = NULL; // Marks the node as not queued
+    cfs_queued_weight -= cfs_weight(process);
+}
+
+/**
+ * Process with the smallest vruntime - the cached leftmost node
+ */
+static process_t *cfs_pick_next(void)
+{
+    rb_node_t *leftmost = rb_first(&cfs_tree);
+    return leftmost ? rb_entry(leftmost, process_t, sched_node) : NULL;
+}
+
+/**
+ * Size the turn: the process's weighted share of the scheduling period
+ */
+static void cfs_set_next(process_t *process)
+{
+    uint32_t weight = cfs_weight(process);
+    uint32_t running = cfs_tree.count + 1;
+    uint64_t granularity = CFS_MS_TO_NS(cfs_min_granularity_ms);
+    uint64_t period = CFS_MS_TO_NS(cfs_latency_ms);
+
+    if (period < granularity * running)
+    {
+        period = granularity * running;
+    }
+
+    uint64_t slice = period * weight / (cfs_queued_weight + weight);
+    if (slice < granularity)
+    {
+        slice = granularity;
+    }
+
+    uint64_t ticks = (slice + CFS_TICK_NS - 1) / CFS_TICK_NS;
+    process->quantum_left = ticks ? (uint32_t)ticks : 1;
+}
+
+static void cfs_put_prev(process_t *process, bool voluntary)
+{
+    (void)process;
+    (void)voluntary; // Runtime is charged per tick; sleeping needs no bonus
+}
+
+/**
+ * Charge one tick of weighted runtime; the turn ends when its slice is
+ * used up and someone else is runnable
+ */
+static bool cfs_tick(process_t *process)
+{
+    process->vruntime += (uint64_t)CFS_TICK_NS * CFS_NICE_0_WEIGHT / cfs_weight(process);
+    cfs_update_min_vruntime(process);
+
+    if (process->quantum_left > 0)
+    {
+        process->quantum_left--;
+    }
+
+    if (process->quantum_left > 0)
+        return false;
+
+    if (!cfs_tree.count)
+    {
+        cfs_set_next(process); // Alone: just start another turn
+        return false;
+    }
+
+    return true;
+}
+
+static void cfs_print_stats(void)
+{
+    vga_print("Target latency: ");
+    vga_print_dec(cfs_latency_ms);
+    vga_print("ms, minimum granularity: ");
+    vga_print_dec(cfs_min_granularity_ms);
+    vga_print("ms\nRunnable: ");
+    vga_print_dec(cfs_tree.count);
+    vga_print(" (weight ");
+    vga_print_dec(cfs_queued_weight);
+    vga_print("), min_vruntime ");
+    vga_print_dec((uint32_t)(cfs_min_vruntime / 1000000));
+    vga_print("ms\n");
+
+    vga_print("PID\tWEIGHT\tVRUNTIME\tNAME\n");
+    for (rb_node_t *node = rb_first(&cfs_tree); node; node = rb_next(node))
+    {
+        process_t *process = rb_entry(node, process_t, sched_node);
+        vga_print_dec(process->pid);
+        vga_print("\t");
+        vga_print_dec(cfs_weight(process));
+        vga_print("\t");
+        vga_print_dec((uint32_t)(process->vruntime / 1000000));
+        vga_print("ms\t\t");
+        vga_print(process->name);
+        vga_print("\n");
+    }
+}
+
+const sched_class_t sched_cfs_class = {
+    .name = "cfs",
+    .init = cfs_init,
+    .enqueue = cfs_enqueue,
+    .dequeue = cfs_dequeue,
+    .pick_next = cfs_pick_next,
+    .set_next = cfs_set_next,
+    .put_prev = cfs_put_prev,
+    .tick = cfs_tick,
+    .print_stats = cfs_print_stats,
+};
@@ -0,0 +1,288 @@
+/* Earliest Deadline First Scheduling Class
+ *
+ * A deadline process reserves `runtime` ticks of CPU in every `period`,
+ * each job finishing within `deadline` ticks of its release. Runnable
+ * deadline processes sit in a red-black tree keyed by absolute deadline,
+ * and the core always asks this class before the one chosen at boot, so
+ * the earliest deadline runs whenever there is one.
+ *
+ * Admission control keeps the summed density runtime / deadline under
+ * EDF_MAX_BANDWIDTH, which (with deadline <= period) is enough for EDF to
+ * meet every deadline and leaves the rest of the CPU to everyone else.
+ *
+ * Reservations are enforced: a job that uses up its budget is throttled,
+ * blocked on its sleep timer until the next period replenishes it. A
+ * process that wakes from an unrelated sleep keeps its deadline only if
+ * its remaining budget still fits before it at the reserved rate;
+ * otherwise it starts a fresh job (the constant bandwidth server rule).
+ */
+
+#include "sched.h"
+#include "../drivers/timer.h"
+
+static rb_tree_t edf_tree;
+static uint32_t edf_bandwidth = 0; // Sum of admitted densities, EDF_BW_UNIT = whole CPU
+static uint32_t edf_tasks = 0;
+
+// Statistics
+static uint32_t edf_throttles = 0;
+static uint32_t edf_misses = 0;
+static uint32_t edf_rejections = 0;
+
+static bool edf_less(const rb_node_t *a, const rb_node_t *b)
+{
+    uint32_t da = rb_entry(a, process_t, dl_node)->dl_abs_deadline;
+    uint32_t db = rb_entry(b, process_t, dl_node)->dl_abs_deadline;
+    return (int32_t)(da - db) < 0;
+}
+
+static inline bool edf_queued(process_t *process)
+{
+    return process->dl_node.parent || edf_tree.root == &process->dl_node;
+}
+
+static inline uint32_t edf_density(uint32_t runtime, uint32_t deadline)
+{
+    return (uint32_t)(((uint64_t)runtime << EDF_BW_SHIFT) / deadline);
+}
+
+/**
+ * Start a job released at tick `release` with a full budget
+ */
+static void edf_new_job(process_t *process, uint32_t release)
+{
+    process->dl_release = release;
+    process->dl_abs_deadline = release + process->dl_deadline;
+    process->dl_budget = process->dl_runtime;
+}
+
+static void edf_init(void)
+{
+    rb_init(&edf_tree);
+    edf_bandwidth = 0;
+    edf_tasks = 0;
+}
+
+static void edf_enqueue(process_t *process, bool wakeup)
+{
+    if (wakeup)
+    {
+        // Keep the deadline only if the budget left fits before it at the
+        // reserved rate: budget / (deadline - now) <= runtime / period
+        uint32_t now = timer_get_ticks();
+        uint32_t left = process->dl_abs_deadline - now;
+        if ((int32_t)left <= 0 ||
+            (uint64_t)process->dl_budget * process->dl_period > (uint64_t)left * process->dl_runtime)
+        {
+            edf_new_job(process, now);
+        }
+    }
+
+    rb_insert(&edf_tree, &process->dl_node, edf_less);
+}
+
+static void edf_dequeue(process_t *process)
+{
+    if (!edf_queued(process))
+        return;
+
+    rb_erase(&edf_tree, &process->dl_node);
+    process->dl_node.parent = NULL; // Marks the node as not queued
+}
+
+/**
+ * Process with the earliest absolute deadline - the cached leftmost node
+ */
+static process_t *edf_pick_next(void)
+{
+    rb_node_t *leftmost = rb_first(&edf_tree);
+    return leftmost ? rb_entry(leftmost, process_t, dl_node) : NULL;
+}
+
+static void edf_set_next(process_t *process)
+{
+    (void)process; // The budget, not a quantum, limits the turn
+}
+
+static void edf_put_prev(process_t *process, bool voluntary)
+{
+    (void)process;
+    (void)voluntary;
+}
+
+/**
+ * Charge one tick to the current job. An exhausted budget throttles the
+ * process until its next period; an earlier deadline preempts it.
+ */
+static bool edf_tick(process_t *process)
+{
+    if (process->dl_budget > 0)
+    {
+        process->dl_budget--;
+    }
+
+    if (process->dl_budget == 0)
+    {
+        uint32_t now = timer_get_ticks();
+        uint32_t next = process->dl_release + process->dl_period;
+
+        edf_throttles++;
+        if ((int32_t)(now - process->dl_abs_deadline) > 0)
+        {
+            edf_misses++;
+        }
+
+        if ((int32_t)(next - now) > 0)
+        {
+            // Blocked on the sleep timer: waking refills it for the new job
+            edf_new_job(process, next);
+            process->state = PROCESS_BLOCKED;
+            process->sleep_until = next;
+            ktimer_add(&process->sleep_timer, next);
+        }
+        else
+        {
+            edf_new_job(process, now); // Overran its whole period
+        }
+        return true;
+    }
+
+    process_t *first = edf_pick_next();
+    return first && (int32_t)(first->dl_abs_deadline - process->dl_abs_deadline) < 0;
+}
+
+/**
+ * Admit a reservation for a process, replacing any it already has. A
+ * deadline of 0 means the period. Returns false if the parameters are
+ * inconsistent or the total density would exceed EDF_MAX_BANDWIDTH.
+ * The process must not be queued.
+ */
+bool edf_admit(process_t *process, uint32_t runtime, uint32_t deadline, uint32_t period)
+{
+    if (!deadline)
+    {
+        deadline = period;
+    }
+
+    if (!runtime || runtime > deadline || deadline > period)
+    {
+        edf_rejections++;
+        return false;
+    }
+
+    uint32_t density = edf_density(runtime, deadline);
+    uint32_t current = process->dl_period ? edf_density(process->dl_runtime, process->dl_deadline) : 0;
+    if (edf_bandwidth - current + density > EDF_MAX_BANDWIDTH)
+    {
+        edf_rejections++;
+        return false;
+    }
+
+    if (!process->dl_period)
+    {
+        edf_tasks++;
+    }
+    edf_bandwidth = edf_bandwidth - current + density;
+
+    process->dl_runtime = runtime;
+    process->dl_deadline = deadline;
+    process->dl_period = period;
+    edf_new_job(process, timer_get_ticks());
+    return true;
+}
+
+/**
+ * Drop a process's reservation and return its bandwidth. Safe to call
+ * for processes without one.
+ */
+void edf_release(process_t *process)
+{
+    if (!process->dl_period)
+        return;
+
+    edf_dequeue(process);
+    edf_bandwidth -= edf_density(process->dl_runtime, process->dl_deadline);
+    edf_tasks--;
+
+    process->dl_runtime = 0;
+    process->dl_deadline = 0;
+    process->dl_period = 0;
+    process->dl_budget = 0;
+}
+
+/**
+ * End the current job: block until the next period releases a new one.
+ * A job that ran past its deadline counts as a miss, and a job that
+ * overran its whole period starts the next one at once.
+ */
+void edf_wait_period(process_t *process)
+{
+    uint32_t now = timer_get_ticks();
+    uint32_t next = process->dl_release + process->dl_period;
+
+    if ((int32_t)(now - process->dl_abs_deadline) > 0)
+    {
+        edf_misses++;
+    }
+
+    if ((int32_t)(next - now) <= 0)
+    {
+        edf_new_job(process, now);
+        return;
+    }
+
+    edf_new_job(process, next);
+    process_sleep(process, next - now);
+}
+
+static void edf_print_stats(void)
+{
+    vga_print("Deadline: ");
+    vga_print_dec(edf_tasks);
+    vga_print(" tasks, bandwidth ");
+    vga_print_dec((uint32_t)(((uint64_t)edf_bandwidth * 100) >> EDF_BW_SHIFT));
+    vga_print("% of ");
+    vga_print_dec((uint32_t)(((uint64_t)EDF_MAX_BANDWIDTH * 100) >> EDF_BW_SHIFT));
+    vga_print("%, throttles ");
+    vga_print_dec(edf_throttles);
+    vga_print(", misses ");
+    vga_print_dec(edf_misses);
+    vga_print(", rejected ");
+    vga_print_dec(edf_rejections);
+    vga_print("\n");
+
+    if (!edf_tasks)
+        return;
+
+    vga_print("PID\tRUNTIME\tDEADLINE\tPERIOD\tBUDGET\tNAME\n");
+    for (process_t *process = process_list; process; process = process->list_next)
+    {
+        if (!process->dl_period)
+            continue;
+
+        vga_print_dec(process->pid);
+        vga_print("\t");
+        vga_print_dec(process->dl_runtime);
+        vga_print("\t");
+        vga_print_dec(process->dl_deadline);
+        vga_print("\t\t");
+        vga_print_dec(process->dl_period);
+        vga_print("\t");
+        vga_print_dec(process->dl_budget);
+        vga_print("\t");
+        vga_print(process->name);
+        vga_print("\n");
+    }
+}
+
+const sched_class_t sched_edf_class = {
+    .name = "edf",
+    .init = edf_init,
+    .enqueue = edf_enqueue,
+    .dequeue = edf_dequeue,
+    .pick_next = edf_pick_next,
+    .set_next = edf_set_next,
+    .put_prev = edf_put_prev,
+    .tick = edf_tick,
+    .print_stats = edf_print_stats,
+};
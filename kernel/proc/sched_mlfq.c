@@ -0,0 +1,260 @@
+/* Multilevel Feedback Queue Scheduling Class
+ *
+ * One FIFO run queue per level plus a bitmap of non-empty levels, so
+ * picking the next process is a find-first-set regardless of how many
+ * are runnable. A process starts at the base level of its priority and
+ * moves with its behaviour:
+ *
+ *   - using up a whole quantum demotes it one level (CPU hogs sink);
+ *   - leaving the CPU with quantum to spare (blocking, yielding) promotes
+ *     it one level, up to one above its base level;
+ *   - every MLFQ_RESET_TICKS everyone returns to their base level, so
+ *     demoted hogs cannot be starved forever.
+ *
+ * Lower levels run less often but for longer: the quantum is the
+ * process's time_slice times (1 + level / 2).
+ */
+
+#include "sched.h"
+
+static process_t *run_queue_head[MLFQ_LEVELS];
+static process_t *run_queue_tail[MLFQ_LEVELS];
+static uint32_t run_queue_length[MLFQ_LEVELS];
+static uint32_t run_queue_bitmap = 0; // Bit n set: level n is not empty
+
+static uint32_t mlfq_ticks_to_reset = MLFQ_RESET_TICKS;
+
+// Statistics
+static uint32_t mlfq_demotions = 0;
+static uint32_t mlfq_promotions = 0;
+static uint32_t mlfq_preemptions = 0;
+
+/**
+ * Level a process of the given priority starts at and returns to
+ */
+static inline uint32_t mlfq_base_level(process_t *process)
+{
+    return MLFQ_BASE_LEVEL(process->priority);
+}
+
+/**
+ * Highest level a process can be promoted to: one above its base
+ */
+static inline uint32_t mlfq_top_level(process_t *process)
+{
+    uint32_t base = mlfq_base_level(process);
+    return base > 0 ? base - 1 : 0;
+}
+
+static inline uint32_t mlfq_quantum(process_t *process)
+{
+    return process->time_slice * (1 + process->sched_level / 2);
+}
+
+static inline bool mlfq_queued(process_t *process)
+{
+    return process->prev || run_queue_head[process->sched_level] == process;
+}
+
+static void mlfq_init(void)
+{
+    for (int level = 0; level < MLFQ_LEVELS; level++)
+    {
+        run_queue_head[level] = NULL;
+        run_queue_tail[level] = NULL;
+        run_queue_length[level] = 0;
+    }
+    run_queue_bitmap = 0;
+    mlfq_ticks_to_reset = MLFQ_RESET_TICKS;
+}
+
+/**
+ * Add process to the tail of its level's run queue
+ */
+static void mlfq_enqueue(process_t *process, bool wakeup)
+{
+    (void)wakeup;
+    uint32_t level = process->sched_level;
+
+    process->next = NULL;
+    process->prev = run_queue_tail[level];
+
+    if (run_queue_tail[level])
+    {
+        run_queue_tail[level]->next = process;
+    }
+    else
+    {
+        run_queue_head[level] = process;
+        run_queue_bitmap |= 1u << level;
+    }
+
+    run_queue_tail[level] = process;
+    run_queue_length[level]++;
+}
+
+/**
+ * Remove process from its run queue
+ */
+static void mlfq_dequeue(process_t *process)
+{
+    uint32_t level = process->sched_level;
+
+    // Not queued - nothing to unlink
+    if (!mlfq_queued(process))
+        return;
+
+    if (process->prev)
+    {
+        process->prev->next = process->next;
+    }
+    else
+    {
+        run_queue_head[level] = process->next;
+    }
+
+    if (process->next)
+    {
+        process->next->prev = process->prev;
+    }
+    else
+    {
+        run_queue_tail[level] = process->prev;
+    }
+
+    if (!run_queue_head[level])
+    {
+        run_queue_bitmap &= ~(1u << level);
+    }
+
+    run_queue_length[level]--;
+    process->next = NULL;
+    process->prev = NULL;
+}
+
+/**
+ * Highest-priority runnable process, or NULL - constant time
+ */
+static process_t *mlfq_pick_next(void)
+{
+    if (!run_queue_bitmap)
+        return NULL;
+    return run_queue_head[__builtin_ctz(run_queue_bitmap)];
+}
+
+/**
+ * A fresh quantum for every turn on the CPU
+ */
+static void mlfq_set_next(process_t *process)
+{
+    process->quantum_left = mlfq_quantum(process);
+}
+
+/**
+ * Giving up the CPU with quantum to spare earns a promotion
+ */
+static void mlfq_put_prev(process_t *process, bool voluntary)
+{
+    if (voluntary && process->quantum_left > 0 && process->sched_level > mlfq_top_level(process))
+    {
+        process->sched_level--;
+        mlfq_promotions++;
+    }
+}
+
+/**
+ * Put every process back at its base level (starvation guard)
+ */
+static void mlfq_reset_levels(void)
+{
+    for (process_t *process = process_list; process; process = process->list_next)
+    {
+        if (process->sched_level == mlfq_base_level(process))
+            continue;
+
+        bool queued = mlfq_queued(process);
+        if (queued)
+        {
+            mlfq_dequeue(process);
+        }
+
+        process->sched_level = mlfq_base_level(process);
+
+        if (queued)
+        {
+            mlfq_enqueue(process, false);
+        }
+    }
+}
+
+/**
+ * Count down the running process's quantum. Reschedule when it runs out,
+ * demoting the process, or when a higher level has work.
+ */
+static bool mlfq_tick(process_t *process)
+{
+    if (--mlfq_ticks_to_reset == 0)
+    {
+        mlfq_ticks_to_reset = MLFQ_RESET_TICKS;
+        mlfq_reset_levels();
+    }
+
+    if (process->quantum_left > 0)
+    {
+        process->quantum_left--;
+    }
+
+    if (process->quantum_left == 0)
+    {
+        // Used the whole quantum: a CPU hog sinks one level
+        if (process->sched_level < MLFQ_LEVELS - 1)
+        {
+            process->sched_level++;
+            mlfq_demotions++;
+        }
+        return true;
+    }
+
+    // Preempt for anything waiting on a higher level
+    if (run_queue_bitmap & ((1u << process->sched_level) - 1))
+    {
+        mlfq_preemptions++;
+        return true;
+    }
+
+    return false;
+}
+
+static void mlfq_print_stats(void)
+{
+    vga_print("LEVEL\tQUANTUM\tREADY\n");
+    for (uint32_t level = 0; level < MLFQ_LEVELS; level++)
+    {
+        vga_print_dec(level);
+        vga_print("\t");
+        vga_print_dec(DEFAULT_TIME_SLICE * (1 + level / 2));
+        vga_print("\t");
+        vga_print_dec(run_queue_length[level]);
+        vga_print("\n");
+    }
+
+    vga_print("Demotions: ");
+    vga_print_dec(mlfq_demotions);
+    vga_print(", promotions: ");
+    vga_print_dec(mlfq_promotions);
+    vga_print(", preemptions: ");
+    vga_print_dec(mlfq_preemptions);
+    vga_print("\n");
+}
+
+const sched_class_t sched_mlfq_class = {
+    .name = "mlfq",
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .dequeue = mlfq_dequeue,
+    .pick_next = mlfq_pick_next,
+    .set_next = mlfq_set_next,
+    .put_prev = mlfq_put_prev,
+    .tick = mlfq_tick,
+    .print_stats = mlfq_print_stats,
+};
@@ -0,0 +1,375 @@
+/* Scheduler Core
+ *
+ * Owns current_process and the context switch, and leaves the order of
+ * runnable processes to a scheduling class: the multilevel feedback
+ * queue (default) or completely fair scheduling, chosen at boot with
+ * sched=mlfq or sched=cfs on the kernel command line. Deadline processes
+ * (sched_edf.c) sit above that class: they are picked first, and waking
+ * one preempts the running process at the next tick rather than at the
+ * end of its quantum.
+ *
+ * Every switch also charges TSC cycles to the processes involved: CPU
+ * time to the one leaving, run-queue wait to the one arriving. Halts and
+ * timer interrupt work are cut out of the running process's CPU time
+ * by moving its account_since forward.
+ */
+
+#include "sched.h"
+#include "../arch/fpu.h"
+#include "../drivers/timer.h"
+
+static const sched_class_t *sched_classes[] = {&sched_mlfq_class, &sched_cfs_class};
+static const sched_class_t *sched = &sched_mlfq_class;
+static bool sched_need_resched = false; // A deadline process woke over a normal one
+
+// Statistics
+static uint32_t sched_switches = 0;
+
+// CPU accounting
+static uint64_t idle_since = 0; // TSC when the CPU halted; 0 while running
+static uint64_t idle_cycles = 0;
+
+const sched_class_t *scheduler_class(void)
+{
+    return sched;
+}
+
+/**
+ * Class that orders a process: the deadline class while it has a
+ * reservation, the boot class otherwise
+ */
+static inline const sched_class_t *scheduler_class_of(process_t *process)
+{
+    return process->dl_period ? &sched_edf_class : sched;
+}
+
+/**
+ * Make a new, forked or woken process runnable. Interrupts are masked
+ * while the class queues change: the timer wakes sleepers into them.
+ */
+void add_to_ready_queue(process_t *process)
+{
+    if (!process || process->state != PROCESS_READY)
+        return;
+
+    uint32_t flags = irq_save();
+    process->account_since = rdtsc(); // Waiting from now
+
+    const sched_class_t *class = scheduler_class_of(process);
+    class->enqueue(process, true);
+
+    if (class == &sched_edf_class && current_process && !current_process->dl_period)
+    {
+        sched_need_resched = true;
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Take a process off the run queue (no-op if it is not queued)
+ */
+void remove_from_ready_queue(process_t *process)
+{
+    if (!process)
+        return;
+
+    uint32_t flags = irq_save();
+    scheduler_class_of(process)->dequeue(process);
+    irq_restore(flags);
+}
+
+/**
+ * Process to run next, or NULL: the earliest deadline, else whatever
+ * the boot class picks
+ */
+process_t *scheduler_get_next(void)
+{
+    process_t *next = sched_edf_class.pick_next();
+    return next ? next : sched->pick_next();
+}
+
+static inline void scheduler_count_switch(process_t *process, bool voluntary)
+{
+    if (!process)
+        return;
+
+    if (voluntary)
+        process->voluntary_switches++;
+    else
+        process->involuntary_switches++;
+}
+
+/**
+ * Switch to the process the class picks. The process giving up the CPU
+ * is requeued if it is still runnable.
+ */
+static void scheduler_switch(bool voluntary)
+{
+    process_t *old_process = current_process;
+
+    scheduler_idle_end(); // Preempted out of a halt
+    sched_need_resched = false;
+    uint64_t now = rdtsc();
+
+    // If current process is still running, it goes back in the run queue
+    if (old_process)
+    {
+        old_process->cpu_cycles += now - old_process->account_since;
+        old_process->account_since = now;
+
+        const sched_class_t *class = scheduler_class_of(old_process);
+        class->put_prev(old_process, voluntary);
+        if (old_process->state == PROCESS_RUNNING)
+        {
+            old_process->state = PROCESS_READY;
+            class->enqueue(old_process, false);
+        }
+    }
+
+    process_t *next_process = scheduler_get_next();
+    if (!next_process)
+    {
+        // No processes ready, switch to idle if needed
+        if (current_process != kernel_process)
+        {
+            scheduler_count_switch(old_process, voluntary);
+            kernel_process->account_since = now;
+            fpu_switch(kernel_process);
+            context_switch(current_process, kernel_process);
+            current_process = kernel_process;
+        }
+        return;
+    }
+
+    // Remove next process from the run queue and mark as running
+    scheduler_class_of(next_process)->dequeue(next_process);
+    scheduler_class_of(next_process)->set_next(next_process);
+    next_process->state = PROCESS_RUNNING;
+    next_process->wait_cycles += now - next_process->account_since;
+    next_process->account_since = now;
+
+    // If next process is the same as current, no switch needed
+    if (next_process == old_process)
+        return;
+
+    // Perform context switch; FPU state follows lazily on first use
+    current_process = next_process;
+    fpu_switch(next_process);
+    sched_switches++;
+    scheduler_count_switch(old_process, voluntary);
+
+    context_switch(old_process, next_process);
+}
+
+/**
+ * Give up the CPU: yield, or block after changing the process state
+ */
+void schedule(void)
+{
+    uint32_t flags = irq_save();
+    scheduler_switch(true);
+    irq_restore(flags);
+}
+
+/**
+ * Give up the CPU after marking the current process BLOCKED, and return
+ * once it has been woken. The kernel process is also the idle task, so
+ * when it blocks with nothing else runnable it idles in place until an
+ * interrupt wakes it.
+ */
+void scheduler_block(void)
+{
+    process_t *process = current_process;
+
+    schedule();
+    while (process == current_process && process->state == PROCESS_BLOCKED)
+    {
+        timer_idle(TIMER_NO_DEADLINE);
+        schedule();
+    }
+}
+
+/**
+ * Give the current process a deadline reservation: `runtime` ticks of
+ * CPU in every `period`, each job due `deadline` ticks after its release
+ * (0: the period). A runtime of 0 drops the reservation. Returns
+ * PROCESS_ERROR if admission control rejects it.
+ */
+int scheduler_set_deadline(uint32_t runtime, uint32_t deadline, uint32_t period)
+{
+    process_t *process = current_process;
+    if (!process || process == kernel_process)
+        return PROCESS_PROTECTED; // The idle task must stay below everyone
+
+    uint32_t flags = irq_save();
+    int result = PROCESS_SUCCESS;
+
+    // The running process is never queued, so it can change class freely
+    if (!runtime)
+    {
+        edf_release(process);
+    }
+    else if (!edf_admit(process, runtime, deadline, period))
+    {
+        result = PROCESS_ERROR;
+    }
+    scheduler_class_of(process)->set_next(process);
+
+    irq_restore(flags);
+    return result;
+}
+
+/**
+ * End the current deadline job and sleep until the next period. For
+ * other processes this is just a yield.
+ */
+void scheduler_wait_period(void)
+{
+    process_t *process = current_process;
+    if (!process || !process->dl_period)
+    {
+        schedule();
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    edf_wait_period(process);
+    irq_restore(flags);
+}
+
+/**
+ * The CPU is about to halt until an interrupt. Called with interrupts off.
+ */
+void scheduler_idle_begin(void)
+{
+    idle_since = rdtsc();
+}
+
+/**
+ * The CPU is running again: the halt counts as idle time, not as CPU time
+ * of the process that halted. Safe to call when not halted.
+ */
+void scheduler_idle_end(void)
+{
+    if (!idle_since)
+        return;
+
+    uint64_t idle = rdtsc() - idle_since;
+    idle_since = 0;
+    idle_cycles += idle;
+    if (current_process)
+    {
+        current_process->account_since += idle;
+    }
+}
+
+/**
+ * Move interrupt work out of the interrupted process's CPU time
+ */
+void scheduler_account_irq(uint64_t cycles)
+{
+    if (current_process)
+    {
+        current_process->irq_cycles += cycles;
+        current_process->account_since += cycles;
+    }
+}
+
+/**
+ * CPU cycles a process has used so far, including its current run
+ */
+uint64_t scheduler_cpu_cycles(process_t *process)
+{
+    uint64_t cycles = process->cpu_cycles;
+    if (process == current_process && !idle_since)
+    {
+        cycles += rdtsc() - process->account_since;
+    }
+    return cycles;
+}
+
+uint64_t scheduler_idle_cycles(void)
+{
+    return idle_cycles;
+}
+
+/**
+ * Scheduler tick - called by timer interrupt. Charges the tick to the
+ * running process and lets the class decide whether its turn is over.
+ */
+void scheduler_tick(void)
+{
+    process_t *process = current_process;
+    if (!process)
+    {
+        scheduler_switch(false);
+        return;
+    }
+
+    process->total_runtime++;
+
+    bool resched = scheduler_class_of(process)->tick(process);
+    if (resched || sched_need_resched)
+    {
+        scheduler_switch(false);
+    }
+}
+
+/**
+ * Get current running process
+ */
+process_t *scheduler_get_current(void)
+{
+    return current_process;
+}
+
+/**
+ * Initialize scheduler with the class named by the sched= boot option
+ */
+void scheduler_init(void)
+{
+    vga_print("  Initializing scheduler...\n");
+
+    char name[16];
+    if (cmdline_get("sched", name, sizeof(name)))
+    {
+        const sched_class_t *chosen = NULL;
+        for (uint32_t i = 0; i < sizeof(sched_classes) / sizeof(sched_classes[0]); i++)
+        {
+            if (strcmp(name, sched_classes[i]->name) == 0)
+            {
+                chosen = sched_classes[i];
+            }
+        }
+
+        if (chosen)
+        {
+            sched = chosen;
+        }
+        else
+        {
+            vga_print("  Unknown scheduler '");
+            vga_print(name);
+            vga_print("', using ");
+            vga_print(sched->name);
+            vga_print("\n");
+        }
+    }
+
+    sched->init();
+    sched_edf_class.init();
+    vga_print("  Scheduler ready (");
+    vga_print(sched->name);
+    vga_print(")\n");
+}
+
+void scheduler_print_stats(void)
+{
+    vga_print("Class: ");
+    vga_print(sched->name);
+    vga_print(", switches: ");
+    vga_print_dec(sched_switches);
+    vga_print("\n");
+    sched->print_stats();
+    sched_edf_class.print_stats();
+}
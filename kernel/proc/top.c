@@ -0,0 +1,184 @@
+/* top
+ *
+ * Live CPU usage per process. Each refresh samples the cycles the
+ * scheduler has charged to every live process, and a process's share is
+ * how much its count grew over the interval. The TSC rate comes from the
+ * same interval measured in timer ticks, so no calibration is needed.
+ */
+
+#include "process.h"
+#include "../drivers/timer.h"
+#include "../drivers/keyboard.h"
+
+#define TOP_REFRESH_TICKS 100 // Redraw every second
+#define TOP_POLL_TICKS 10     // Check for a key this often
+#define TOP_ROWS 16           // Processes shown
+
+typedef struct
+{
+    process_t *process;
+    uint64_t delta; // CPU cycles used in the last interval
+} top_row_t;
+
+// Previous sample, by PID
+static uint32_t top_sample_pids[MAX_PROCESSES];
+static uint64_t top_sample_cycles[MAX_PROCESSES];
+static uint32_t top_samples = 0;
+
+static top_row_t top_rows[MAX_PROCESSES];
+
+static uint64_t top_previous_cycles(uint32_t pid)
+{
+    for (uint32_t i = 0; i < top_samples; i++)
+    {
+        if (top_sample_pids[i] == pid)
+            return top_sample_cycles[i];
+    }
+    return 0; // New since the last sample
+}
+
+/**
+ * Remember every live process's cycle count for the next interval
+ */
+static void top_sample(void)
+{
+    top_samples = 0;
+    for (process_t *process = process_list; process && top_samples < MAX_PROCESSES; process = process->list_next)
+    {
+        top_sample_pids[top_samples] = process->pid;
+        top_sample_cycles[top_samples] = scheduler_cpu_cycles(process);
+        top_samples++;
+    }
+}
+
+/**
+ * Print `part` of `whole` as a percentage with one decimal
+ */
+static void top_print_percent(uint64_t part, uint64_t whole)
+{
+    uint32_t tenths = whole ? (uint32_t)(part * 1000 / whole) : 0;
+    vga_print_dec(tenths / 10);
+    vga_putchar('.');
+    vga_print_dec(tenths % 10);
+    vga_print("%");
+}
+
+static void top_print_ms(uint64_t cycles, uint64_t cycles_per_ms)
+{
+    vga_print_dec(cycles_per_ms ? (uint32_t)(cycles / cycles_per_ms) : 0);
+}
+
+/**
+ * Sample every live process, sort by CPU used since the previous sample
+ * and redraw the screen
+ */
+static void top_refresh(uint64_t interval, uint32_t interval_ticks, uint64_t idle)
+{
+    uint64_t cycles_per_ms = interval_ticks ? interval / (interval_ticks * (1000 / TIMER_FREQUENCY)) : 0;
+    uint32_t count = 0;
+
+    for (process_t *process = process_list; process && count < MAX_PROCESSES; process = process->list_next)
+    {
+        uint64_t cycles = scheduler_cpu_cycles(process);
+        uint64_t delta = cycles - top_previous_cycles(process->pid);
+
+        // Insertion sort, busiest first
+        uint32_t i = count++;
+        while (i > 0 && top_rows[i - 1].delta < delta)
+        {
+            top_rows[i] = top_rows[i - 1];
+            i--;
+        }
+        top_rows[i].process = process;
+        top_rows[i].delta = delta;
+    }
+
+    top_sample();
+
+    vga_clear();
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    vga_print("top - up ");
+    vga_print_dec(timer_get_ticks() / TIMER_FREQUENCY);
+    vga_print("s, ");
+    vga_print_dec(process_count);
+    vga_print(" processes, idle ");
+    top_print_percent(idle, interval);
+    vga_print(" (any key quits)\n");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_print("PID\tCPU\tCPU ms\tIRQ ms\tWAIT ms\tVOL\tINVOL\tNAME\n");
+
+    for (uint32_t i = 0; i < count && i < TOP_ROWS; i++)
+    {
+        process_t *process = top_rows[i].process;
+        vga_print_dec(process->pid);
+        vga_print("\t");
+        top_print_percent(top_rows[i].delta, interval);
+        vga_print("\t");
+        top_print_ms(scheduler_cpu_cycles(process), cycles_per_ms);
+        vga_print("\t");
+        top_print_ms(process->irq_cycles, cycles_per_ms);
+        vga_print("\t");
+        top_print_ms(process->wait_cycles, cycles_per_ms);
+        vga_print("\t");
+        vga_print_dec(process->voluntary_switches);
+        vga_print("\t");
+        vga_print_dec(process->involuntary_switches);
+        vga_print("\t");
+        vga_print(process->name);
+        vga_print("\n");
+    }
+}
+
+/**
+ * True once a key has been pressed; consumes whatever the controller holds
+ */
+static bool top_key_pressed(void)
+{
+    bool pressed = false;
+    while (inb(KEYBOARD_STATUS_PORT) & KEYBOARD_OUTPUT_FULL)
+    {
+        if (!(inb(KEYBOARD_DATA_PORT) & 0x80))
+            pressed = true; // A make code, not a release
+    }
+    return pressed;
+}
+
+/**
+ * Redraw per-process CPU usage every second until a key is pressed. The
+ * shell sleeps in between, so top itself barely shows up.
+ */
+void process_top(void)
+{
+    top_key_pressed(); // Drop the release of the Enter that started us
+
+    uint64_t start = rdtsc();
+    uint64_t idle_start = scheduler_idle_cycles();
+    uint32_t ticks_start = timer_get_ticks();
+    top_sample();
+
+    vga_clear();
+    vga_print("top: sampling...\n");
+
+    while (1)
+    {
+        for (uint32_t waited = 0; waited < TOP_REFRESH_TICKS; waited += TOP_POLL_TICKS)
+        {
+            timer_sleep(TOP_POLL_TICKS);
+            if (top_key_pressed())
+            {
+                vga_clear();
+                return;
+            }
+        }
+
+        uint64_t now = rdtsc();
+        uint64_t idle_now = scheduler_idle_cycles();
+        uint32_t ticks_now = timer_get_ticks();
+
+        top_refresh(now - start, ticks_now - ticks_start, idle_now - idle_start);
+
+        start = now;
+        idle_start = idle_now;
+        ticks_start = ticks_now;
+    }
+}
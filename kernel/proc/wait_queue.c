@@ -0,0 +1,121 @@
+/* Wait Queues
+ *
+ * A FIFO of blocked processes. Sleeping marks the current process
+ * BLOCKED and gives up the CPU; waking takes processes off the front and
+ * makes them runnable again. A woken process re-checks its condition, as
+ * another process may have got there first.
+ */
+
+#include "wait_queue.h"
+#include "process.h"
+
+void wait_queue_init(wait_queue_t *queue)
+{
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+/**
+ * Block the current process on `queue` until it is woken
+ */
+void wait_queue_sleep(wait_queue_t *queue)
+{
+    process_t *process = current_process;
+    if (!process)
+        return;
+
+    uint32_t flags = irq_save();
+
+    process->wait_next = NULL;
+    process->wait_queue = queue;
+    if (queue->tail)
+        queue->tail->wait_next = process;
+    else
+        queue->head = process;
+    queue->tail = process;
+
+    process->state = PROCESS_BLOCKED;
+    scheduler_block();
+
+    irq_restore(flags);
+}
+
+/**
+ * Take the first process off the queue without waking it
+ */
+static process_t *wait_queue_pop(wait_queue_t *queue)
+{
+    process_t *process = queue->head;
+    if (!process)
+        return NULL;
+
+    queue->head = process->wait_next;
+    if (!queue->head)
+        queue->tail = NULL;
+    process->wait_next = NULL;
+    process->wait_queue = NULL;
+    return process;
+}
+
+/**
+ * Wake the longest-waiting process. Returns false if the queue was empty.
+ */
+bool wait_queue_wake_one(wait_queue_t *queue)
+{
+    uint32_t flags = irq_save();
+    process_t *process = wait_queue_pop(queue);
+    if (process)
+    {
+        process_wake(process);
+    }
+    irq_restore(flags);
+    return process != NULL;
+}
+
+/**
+ * Wake every waiting process. Returns how many were woken.
+ */
+uint32_t wait_queue_wake_all(wait_queue_t *queue)
+{
+    uint32_t flags = irq_save();
+    uint32_t woken = 0;
+    process_t *process;
+    while ((process = wait_queue_pop(queue)))
+    {
+        process_wake(process);
+        woken++;
+    }
+    irq_restore(flags);
+    return woken;
+}
+
+/**
+ * Take a process off whatever queue it sleeps on, without waking it
+ */
+void wait_queue_remove(process_t *process)
+{
+    uint32_t flags = irq_save();
+    wait_queue_t *queue = process->wait_queue;
+
+    if (queue)
+    {
+        process_t *prev = NULL;
+        for (process_t *entry = queue->head; entry; prev = entry, entry = entry->wait_next)
+        {
+            if (entry != process)
+                continue;
+
+            if (prev)
+                prev->wait_next = process->wait_next;
+            else
+                queue->head = process->wait_next;
+            if (queue->tail == process)
+                queue->tail = prev;
+            break;
+        }
+        process->wait_next = NULL;
+        process->wait_queue = NULL;
+    }
+
+    irq_restore(flags);
+}
@@ -0,0 +1,28 @@
+#ifndef WAIT_QUEUE_H
+#define WAIT_QUEUE_H
+
+#include "kernel.h"
+
+struct process;
+
+// Processes blocked until some event; linked through process_t.wait_next.
+// Check the condition and sleep with interrupts masked, or a wake-up that
+// lands in between is lost.
+typedef struct wait_queue
+{
+    struct process *head;
+    struct process *tail;
+} wait_queue_t;
+
+void wait_queue_init(wait_queue_t *queue);
+void wait_queue_sleep(wait_queue_t *queue);
+bool wait_queue_wake_one(wait_queue_t *queue);
+uint32_t wait_queue_wake_all(wait_queue_t *queue);
+void wait_queue_remove(struct process *process);
+
+static inline bool wait_queue_empty(wait_queue_t *queue)
+{
+    return queue->head == NULL;
+}
+
+#endif
@@ -0,0 +1,304 @@
+/* Red-Black Tree
+ *
+ * Textbook (CLRS) insertion and deletion with NULL leaves. Deletion
+ * tracks the parent of the replacement node separately, since the
+ * replacement may be a NULL leaf.
+ */
+
+#include "rbtree.h"
+
+void rb_init(rb_tree_t *tree)
+{
+    tree->root = NULL;
+    tree->leftmost = NULL;
+    tree->count = 0;
+}
+
+static inline bool rb_is_red(rb_node_t *node)
+{
+    return node && node->red;
+}
+
+/**
+ * Put `new_child` where `old_child` hangs below `parent` (or at the root)
+ */
+static void rb_replace_child(rb_tree_t *tree, rb_node_t *parent, rb_node_t *old_child, rb_node_t *new_child)
+{
+    if (!parent)
+        tree->root = new_child;
+    else if (parent->left == old_child)
+        parent->left = new_child;
+    else
+        parent->right = new_child;
+}
+
+static void rb_rotate_left(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *pivot = node->right;
+
+    node->right = pivot->left;
+    if (pivot->left)
+        pivot->left->parent = node;
+
+    pivot->parent = node->parent;
+    rb_replace_child(tree, node->parent, node, pivot);
+
+    pivot->left = node;
+    node->parent = pivot;
+}
+
+static void rb_rotate_right(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *pivot = node->left;
+
+    node->left = pivot->right;
+    if (pivot->right)
+        pivot->right->parent = node;
+
+    pivot->parent = node->parent;
+    rb_replace_child(tree, node->parent, node, pivot);
+
+    pivot->right = node;
+    node->parent = pivot;
+}
+
+/**
+ * Insert `node`, ordered by `less`
+ */
+void rb_insert(rb_tree_t *tree, rb_node_t *node, rb_less_t less)
+{
+    rb_node_t *parent = NULL;
+    rb_node_t **link = &tree->root;
+    bool leftmost = true;
+
+    while (*link)
+    {
+        parent = *link;
+        if (less(node, parent))
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = true;
+    *link = node;
+
+    if (leftmost)
+        tree->leftmost = node;
+    tree->count++;
+
+    // Restore the red-black properties
+    while (rb_is_red(node->parent))
+    {
+        parent = node->parent;
+        rb_node_t *grandparent = parent->parent;
+
+        if (parent == grandparent->left)
+        {
+            rb_node_t *uncle = grandparent->right;
+            if (rb_is_red(uncle))
+            {
+                parent->red = false;
+                uncle->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+
+            if (node == parent->right)
+            {
+                rb_rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+
+            parent->red = false;
+            grandparent->red = true;
+            rb_rotate_right(tree, grandparent);
+        }
+        else
+        {
+            rb_node_t *uncle = grandparent->left;
+            if (rb_is_red(uncle))
+            {
+                parent->red = false;
+                uncle->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+
+            if (node == parent->left)
+            {
+                rb_rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+
+            parent->red = false;
+            grandparent->red = true;
+            rb_rotate_left(tree, grandparent);
+        }
+    }
+
+    tree->root->red = false;
+}
+
+/**
+ * In-order successor, or NULL
+ */
+rb_node_t *rb_next(rb_node_t *node)
+{
+    if (node->right)
+    {
+        node = node->right;
+        while (node->left)
+            node = node->left;
+        return node;
+    }
+
+    while (node->parent && node == node->parent->right)
+        node = node->parent;
+    return node->parent;
+}
+
+/**
+ * Remove `node` from the tree
+ */
+void rb_erase(rb_tree_t *tree, rb_node_t *node)
+{
+    if (tree->leftmost == node)
+        tree->leftmost = rb_next(node);
+    tree->count--;
+
+    rb_node_t *child;  // Node that moves into the removed position
+    rb_node_t *parent; // Its parent after the removal
+    bool removed_red;
+
+    if (!node->left || !node->right)
+    {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        removed_red = node->red;
+
+        if (child)
+            child->parent = parent;
+        rb_replace_child(tree, parent, node, child);
+    }
+    else
+    {
+        // Two children: the successor takes the node's place and colour
+        rb_node_t *successor = node->right;
+        while (successor->left)
+            successor = successor->left;
+
+        child = successor->right;
+        removed_red = successor->red;
+
+        if (successor->parent == node)
+        {
+            parent = successor;
+        }
+        else
+        {
+            parent = successor->parent;
+            parent->left = child;
+            if (child)
+                child->parent = parent;
+
+            successor->right = node->right;
+            node->right->parent = successor;
+        }
+
+        successor->left = node->left;
+        node->left->parent = successor;
+        successor->parent = node->parent;
+        successor->red = node->red;
+        rb_replace_child(tree, node->parent, node, successor);
+    }
+
+    if (removed_red)
+        return;
+
+    // A black node left: push the missing black up or rebalance
+    while (child != tree->root && !rb_is_red(child))
+    {
+        if (child == parent->left)
+        {
+            rb_node_t *sibling = parent->right;
+            if (rb_is_red(sibling))
+            {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right))
+            {
+                sibling->red = true;
+                child = parent;
+                parent = child->parent;
+                continue;
+            }
+
+            if (!rb_is_red(sibling->right))
+            {
+                sibling->left->red = false;
+                sibling->red = true;
+                rb_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->right->red = false;
+            rb_rotate_left(tree, parent);
+            child = tree->root;
+        }
+        else
+        {
+            rb_node_t *sibling = parent->left;
+            if (rb_is_red(sibling))
+            {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right))
+            {
+                sibling->red = true;
+                child = parent;
+                parent = child->parent;
+                continue;
+            }
+
+            if (!rb_is_red(sibling->left))
+            {
+                sibling->right->red = false;
+                sibling->red = true;
+                rb_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->left->red = false;
+            rb_rotate_right(tree, parent);
+            child = tree->root;
+        }
+    }
+
+    if (child)
+        child->red = false;
+}
@@ -0,0 +1,39 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include "kernel.h"
+
+// Intrusive red-black tree: embed an rb_node_t in the object and get back
+// to the object with rb_entry(). The leftmost node is cached, so the
+// minimum is O(1); insert and erase are O(log n).
+typedef struct rb_node
+{
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    bool red;
+} rb_node_t;
+
+typedef struct rb_tree
+{
+    rb_node_t *root;
+    rb_node_t *leftmost; // Smallest node, or NULL when empty
+    uint32_t count;
+} rb_tree_t;
+
+// Strict ordering of two nodes; equal keys go to the right (FIFO among ties)
+typedef bool (*rb_less_t)(const rb_node_t *a, const rb_node_t *b);
+
+#define rb_entry(node, type, member) ((type *)((uint8_t *)(node) - offsetof(type, member)))
+
+void rb_init(rb_tree_t *tree);
+void rb_insert(rb_tree_t *tree, rb_node_t *node, rb_less_t less);
+void rb_erase(rb_tree_t *tree, rb_node_t *node);
+rb_node_t *rb_next(rb_node_t *node);
+
+static inline rb_node_t *rb_first(rb_tree_t *tree)
+{
+    return tree->leftmost;
+}
+
+#endif
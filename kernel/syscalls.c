@@ -50,12 +50,24 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
     case SYS_WAIT:
         return sys_wait((uint32_t *)arg1);
 
+    case SYS_WAITPID:
+        return sys_waitpid((int32_t)arg1, (uint32_t *)arg2, arg3);
+
     case SYS_GETPID:
         return sys_getpid();
 
     case SYS_KILL:
         return sys_kill(arg1, (int)arg2);
 
+    case SYS_BRK:
+        return sys_brk(arg1);
+
+    case SYS_SBRK:
+        return sys_sbrk((int32_t)arg1);
+
+    case SYS_SCHED_DEADLINE:
+        return sys_sched_deadline(arg1, arg2, arg3);
+
     default:
         vga_print("Unknown system call: ");
         vga_print_hex(syscall_num);
@@ -71,24 +83,14 @@ void sys_exit(int exit_code)
 {
     if (current_process)
     {
-        current_process->state = PROCESS_TERMINATED;
-        current_process->exit_code = exit_code;
-
         vga_print("Process ");
         vga_print_hex(current_process->pid);
         vga_print(" exited with code ");
         vga_print_hex(exit_code);
         vga_print("\n");
 
-        // Remove from ready queue if present
-        if (current_process->state == PROCESS_READY)
-        {
-            remove_from_ready_queue(current_process);
-        }
-
-        // Schedule next process
-        current_process = NULL;
-        schedule();
+        // Becomes a zombie for the parent to reap; does not return
+        process_exit(exit_code);
     }
 }
 
@@ -109,14 +111,17 @@ uint32_t sys_fork(void)
         return -1; // Fork failed
     }
 
+    // The child comes back here too once it runs, on its copy of the stack
+    if (child == current_process)
+    {
+        return 0;
+    }
+
     // Set parent-child relationship
     child->parent_pid = current_process->pid;
 
-    // Add child to ready queue
+    // Add child to ready queue; the parent gets the child's PID
     add_to_ready_queue(child);
-
-    // Return PID to parent, 0 to child (when child runs)
-    // For now, just return child PID since we don't have proper process switching yet
     return child->pid;
 }
 
@@ -172,37 +177,61 @@ int sys_exec(const char *program, char *const argv[])
 }
 
 /**
- * Wait for child process to terminate
+ * Wait for any child process to terminate
  */
 uint32_t sys_wait(uint32_t *status)
+{
+    return sys_waitpid(-1, status, 0);
+}
+
+/**
+ * Wait for a child (pid > 0) or any child (pid = -1) to terminate and
+ * reap it. Blocks on the caller's child_exit queue until one does, unless
+ * WAIT_NOHANG is given. Returns the child's PID, 0 for WAIT_NOHANG with
+ * no exited child yet, or -1 if there is no such child at all.
+ */
+uint32_t sys_waitpid(int32_t pid, uint32_t *status, uint32_t options)
 {
     if (!current_process)
     {
         return -1;
     }
 
-    // Find terminated child process
-    for (int i = 0; i < MAX_PROCESSES; i++)
+    // Masked from the check to the sleep, so an exit cannot slip in between
+    uint32_t flags = irq_save();
+
+    while (1)
     {
-        process_t *proc = process_table[i];
-        if (proc && proc->parent_pid == current_process->pid &&
-            proc->state == PROCESS_TERMINATED)
+        bool have_child = false;
+        for (process_t *child = current_process->children; child; child = child->next_child)
         {
+            if (pid > 0 && child->pid != (uint32_t)pid)
+                continue;
 
-            uint32_t child_pid = proc->pid;
-            if (status)
+            have_child = true;
+            if (child->state == PROCESS_TERMINATED)
             {
-                *status = proc->exit_code;
+                uint32_t child_pid = child->pid;
+                if (status)
+                {
+                    *status = child->exit_code;
+                }
+
+                // Free the zombie
+                process_cleanup(child);
+                irq_restore(flags);
+                return child_pid;
             }
+        }
 
-            // Clean up terminated child
-            process_cleanup(proc);
-            return child_pid;
+        if (!have_child || (options & WAIT_NOHANG))
+        {
+            irq_restore(flags);
+            return have_child ? 0 : (uint32_t)-1;
         }
-    }
 
-    // No terminated children found - would normally block here
-    return 0;
+        wait_queue_sleep(&current_process->child_exit);
+    }
 }
 
 /**
@@ -242,13 +271,18 @@ int sys_kill(uint32_t pid, int signal)
     // For now, just simulate signal 9 (SIGKILL)
     if (signal == 9)
     {
-        target->state = PROCESS_TERMINATED;
-        target->exit_code = -1;
-
         vga_print("Killed process ");
         vga_print_hex(pid);
         vga_print("\n");
 
+        // Killing itself: become a zombie and give up the CPU for good,
+        // as sys_exit does
+        if (target == current_process)
+        {
+            process_exit(PROCESS_EXIT_KILLED);
+        }
+
+        process_terminate(target, PROCESS_EXIT_KILLED);
         return 0;
     }
 
@@ -260,3 +294,62 @@ int sys_kill(uint32_t pid, int signal)
 
     return 0;
 }
+
+/**
+ * Set the heap break of the current process. Returns the resulting break:
+ * the requested one on success, the unchanged one on failure (pass 0 to
+ * query it), or 0 if the process has no heap.
+ */
+uint32_t sys_brk(uint32_t new_break)
+{
+    if (!current_process || !current_process->heap_base)
+    {
+        return 0;
+    }
+
+    if (new_break)
+    {
+        process_set_break(current_process, new_break);
+    }
+
+    return current_process->heap_base + current_process->heap_size;
+}
+
+/**
+ * Grow or shrink the heap of the current process by `increment` bytes.
+ * Returns the previous break, or -1 if the heap cannot move that far.
+ */
+uint32_t sys_sbrk(int32_t increment)
+{
+    if (!current_process || !current_process->heap_base)
+    {
+        return -1;
+    }
+
+    uint32_t old_break = current_process->heap_base + current_process->heap_size;
+    uint32_t new_break = old_break + (uint32_t)increment;
+
+    // Reject wrap-around in either direction
+    if ((increment > 0 && new_break < old_break) || (increment < 0 && new_break > old_break))
+    {
+        return -1;
+    }
+
+    if (!process_set_break(current_process, new_break))
+    {
+        return -1;
+    }
+
+    return old_break;
+}
+
+/**
+ * Reserve runtime ticks of CPU in every period for the calling process,
+ * each job due deadline ticks after its release (0: the period); a
+ * runtime of 0 drops the reservation. Returns 0, or -1 if admission
+ * control rejects it.
+ */
+int sys_sched_deadline(uint32_t runtime, uint32_t deadline, uint32_t period)
+{
+    return scheduler_set_deadline(runtime, deadline, period) == PROCESS_SUCCESS ? 0 : -1;
+}
@@ -11,6 +11,13 @@
 #define SYS_WAIT 4
 #define SYS_GETPID 5
 #define SYS_KILL 6
+#define SYS_BRK 7
+#define SYS_SBRK 8
+#define SYS_WAITPID 9
+#define SYS_SCHED_DEADLINE 10
+
+// waitpid options
+#define WAIT_NOHANG 1 // Return 0 instead of blocking when no child has exited
 
 // System call interface
 void syscall_init(void);
@@ -21,7 +28,11 @@ void sys_exit(int exit_code);
 uint32_t sys_fork(void);
 int sys_exec(const char *program, char *const argv[]);
 uint32_t sys_wait(uint32_t *status);
+uint32_t sys_waitpid(int32_t pid, uint32_t *status, uint32_t options);
 uint32_t sys_getpid(void);
 int sys_kill(uint32_t pid, int signal);
+uint32_t sys_brk(uint32_t new_break);
+uint32_t sys_sbrk(int32_t increment);
+int sys_sched_deadline(uint32_t runtime, uint32_t deadline, uint32_t period);
 
 #endif
@@ -0,0 +1,196 @@
+/* Process Heap Allocator
+ *
+ * malloc/free for processes, served from the calling process's heap
+ * region. Small requests come from per-size-class free lists and only
+ * enter the kernel (SYS_SBRK) to grow the heap by a whole chunk; large
+ * requests are carved straight off the break. The allocator state lives
+ * at the bottom of the heap, so every address space has its own, and all
+ * of it goes away with the process.
+ */
+
+#include "malloc.h"
+#include "../kernel/syscalls.h"
+#include "../kernel/mem/vmm.h"
+
+#define MALLOC_MIN_SHIFT 4 // Smallest class: 16 bytes including the header
+#define MALLOC_CLASSES 8   // 16, 32, ... 2048 bytes
+#define MALLOC_MAX_SMALL (1u << (MALLOC_MIN_SHIFT + MALLOC_CLASSES - 1))
+#define MALLOC_CHUNK 0x4000 // Heap growth for small blocks (16KB)
+#define MALLOC_ALIGN 16
+#define MALLOC_LARGE_CLASS 0xFFFFFFFF
+
+// Header in front of every block; payloads are 8-byte aligned
+typedef struct malloc_block
+{
+    uint32_t size;  // Block size including the header
+    uint32_t klass; // Size class, or MALLOC_LARGE_CLASS
+} malloc_block_t;
+
+// Free blocks reuse their payload for the list link
+typedef struct malloc_free
+{
+    malloc_block_t header;
+    struct malloc_free *next;
+} malloc_free_t;
+
+typedef struct
+{
+    malloc_free_t *small_free[MALLOC_CLASSES];
+    malloc_free_t *large_free; // First fit, unsorted
+    uint32_t chunk_next;       // Uncarved part of the current small chunk
+    uint32_t chunk_end;
+    uint32_t brk; // Current break (only this allocator moves it)
+} malloc_state_t;
+
+/**
+ * Find the allocator state of the current process, creating it on the
+ * first call. Returns NULL if the process has no heap region.
+ */
+static malloc_state_t *malloc_get_state(void)
+{
+    malloc_state_t *state = (malloc_state_t *)PROCESS_HEAP_BASE;
+
+    if (current_process && current_process->heap_base == PROCESS_HEAP_BASE && current_process->heap_size)
+        return state;
+
+    uint32_t base = sys_sbrk((sizeof(malloc_state_t) + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1));
+    if (base != PROCESS_HEAP_BASE)
+        return NULL;
+
+    // Fresh heap pages are demand-zeroed, so only the break needs setting
+    state->brk = sys_brk(0);
+    return state;
+}
+
+/**
+ * Grow the heap by `size` bytes. Returns the old break, or 0.
+ */
+static uint32_t malloc_grow(malloc_state_t *state, uint32_t size)
+{
+    uint32_t base = sys_sbrk((int32_t)size);
+    if (base == (uint32_t)-1)
+        return 0;
+
+    state->brk = base + size;
+    return base;
+}
+
+static void *malloc_small(malloc_state_t *state, uint32_t klass)
+{
+    malloc_free_t *block = state->small_free[klass];
+    if (block)
+    {
+        state->small_free[klass] = block->next;
+        return (uint8_t *)block + sizeof(malloc_block_t);
+    }
+
+    uint32_t size = 1u << (klass + MALLOC_MIN_SHIFT);
+    if (state->chunk_end - state->chunk_next < size)
+    {
+        // The tail of the old chunk is dropped; it is smaller than this class
+        uint32_t chunk = malloc_grow(state, MALLOC_CHUNK);
+        if (!chunk)
+            return NULL;
+        state->chunk_next = chunk;
+        state->chunk_end = chunk + MALLOC_CHUNK;
+    }
+
+    malloc_block_t *header = (malloc_block_t *)state->chunk_next;
+    state->chunk_next += size;
+    header->size = size;
+    header->klass = klass;
+    return header + 1;
+}
+
+static void *malloc_large(malloc_state_t *state, uint32_t size)
+{
+    size = (size + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+
+    for (malloc_free_t **link = &state->large_free; *link; link = &(*link)->next)
+    {
+        malloc_free_t *block = *link;
+        if (block->header.size >= size)
+        {
+            *link = block->next;
+            return (uint8_t *)block + sizeof(malloc_block_t);
+        }
+    }
+
+    malloc_block_t *header = (malloc_block_t *)malloc_grow(state, size);
+    if (!header)
+        return NULL;
+
+    header->size = size;
+    header->klass = MALLOC_LARGE_CLASS;
+    return header + 1;
+}
+
+/**
+ * Allocate `size` bytes from the current process's heap
+ */
+void *malloc(size_t size)
+{
+    if (size == 0 || size > PROCESS_HEAP_LIMIT - PROCESS_HEAP_BASE)
+        return NULL;
+
+    malloc_state_t *state = malloc_get_state();
+    if (!state)
+        return NULL;
+
+    uint32_t total = size + sizeof(malloc_block_t);
+    if (total > MALLOC_MAX_SMALL)
+        return malloc_large(state, total);
+
+    uint32_t klass = 0;
+    while ((1u << (klass + MALLOC_MIN_SHIFT)) < total)
+    {
+        klass++;
+    }
+    return malloc_small(state, klass);
+}
+
+/**
+ * Allocate a zeroed array of `count` elements of `size` bytes
+ */
+void *calloc(size_t count, size_t size)
+{
+    if (size && count > (size_t)-1 / size)
+        return NULL;
+
+    void *ptr = malloc(count * size);
+    if (ptr)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+/**
+ * Return a block to the allocator. A large block at the top of the heap
+ * is given back to the kernel straight away.
+ */
+void free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    malloc_state_t *state = (malloc_state_t *)PROCESS_HEAP_BASE;
+    malloc_free_t *block = (malloc_free_t *)((malloc_block_t *)ptr - 1);
+
+    if (block->header.klass != MALLOC_LARGE_CLASS)
+    {
+        block->next = state->small_free[block->header.klass];
+        state->small_free[block->header.klass] = block;
+        return;
+    }
+
+    if ((uint32_t)block + block->header.size == state->brk &&
+        sys_sbrk(-(int32_t)block->header.size) != (uint32_t)-1)
+    {
+        state->brk = (uint32_t)block;
+        return;
+    }
+
+    block->next = state->large_free;
+    state->large_free = block;
+}
@@ -0,0 +1,13 @@
+#ifndef MALLOC_H
+#define MALLOC_H
+
+#include "../kernel/kernel.h"
+
+// Process-side allocator on top of the per-process heap (SYS_SBRK).
+// Memory comes from the calling process's own address space and is
+// released with it; a process using malloc must not move its break itself.
+void *malloc(size_t size);
+void *calloc(size_t count, size_t size);
+void free(void *ptr);
+
+#endif
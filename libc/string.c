@@ -1,24 +1,137 @@
 /* Standard Library Functions */
 
 #include "../kernel/kernel.h"
+#include "../kernel/arch/cpu.h"
+#include "../kernel/arch/fpu.h"
 
-size_t strlen(const char *str)
+// Every copy and fill ends in rep movs/stos: with fast-string support the
+// CPU moves whole cache lines internally, and the byte loops these replace
+// are at risk of being turned back into calls to themselves by the compiler
+#define STRING_STREAM_MIN 0x40000 // 256KB: larger copies/fills bypass the cache (SSE2)
+
+// Dword access that may alias any other type
+typedef uint32_t __attribute__((may_alias)) string_word_t;
+
+/* The string scans below read a dword (SWAR) or 16 bytes (SSE2) at a time.
+ * They may read past the terminator, but never across a page boundary: an
+ * aligned read stays inside the page of its first byte, and an unaligned
+ * one is only issued when it ends in the same page as it starts.
+ */
+#define STRING_ONES 0x01010101u
+#define STRING_HIGHS 0x80808080u
+#define STRING_PAGE_SIZE 4096
+
+/* Most strings the kernel and shell scan are short, so the scans start
+ * with SWAR and only move to SSE2 after STRING_SSE2_MIN bytes. Even then
+ * SSE2 is used only when the FPU is already live for the running task:
+ * with the lazy-switch trap armed, the first XMM access would #NM and make
+ * an integer-only task an FPU owner, with a save and restore at every
+ * later switch.
+ */
+#define STRING_SSE2_MIN 64
+
+static inline bool string_sse2_usable(void)
 {
-    size_t len = 0;
-    while (str[len])
-    {
-        len++;
-    }
-    return len;
+    return cpu_sse2_enabled && !fpu_trap_armed;
+}
+
+// Non-zero if any byte of `word` is zero; the lowest flagged byte is exact
+static inline uint32_t word_has_zero(uint32_t word)
+{
+    return (word - STRING_ONES) & ~word & STRING_HIGHS;
+}
+
+// Index of the byte flagged by word_has_zero() (little endian)
+static inline uint32_t word_first_flag(uint32_t flags)
+{
+    return __builtin_ctz(flags) >> 3;
+}
+
+// True if `size` bytes from `ptr` lie in one page
+static inline bool string_read_safe(const void *ptr, uint32_t size)
+{
+    return ((uint32_t)ptr & (STRING_PAGE_SIZE - 1)) <= STRING_PAGE_SIZE - size;
+}
+
+/**
+ * Fill 64-byte blocks with non-temporal SSE2 stores, from a 16-byte aligned
+ * destination. Streaming stores skip the cache, so a large fill does not
+ * evict everything else. Returns the address after the last block.
+ * (target("sse2") only lets the asm name XMM registers; the kernel itself
+ * is built without SSE code generation.)
+ */
+__attribute__((target("sse2"))) static uint8_t *stream_fill(uint8_t *dest, uint32_t pattern, size_t blocks)
+{
+    asm volatile(
+        "movd %2, %%xmm0\n\t"
+        "pshufd $0, %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movntdq %%xmm0, (%0)\n\t"
+        "movntdq %%xmm0, 16(%0)\n\t"
+        "movntdq %%xmm0, 32(%0)\n\t"
+        "movntdq %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(dest), "+r"(blocks)
+        : "r"(pattern)
+        : "xmm0", "memory");
+    return dest;
+}
+
+/**
+ * Copy 64-byte blocks to a 16-byte aligned destination with non-temporal
+ * SSE2 stores (the source may be unaligned)
+ */
+__attribute__((target("sse2"))) static void stream_copy(uint8_t **dest, const uint8_t **src, size_t blocks)
+{
+    asm volatile(
+        "1:\n\t"
+        "movdqu (%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movntdq %%xmm0, (%0)\n\t"
+        "movntdq %%xmm1, 16(%0)\n\t"
+        "movntdq %%xmm2, 32(%0)\n\t"
+        "movntdq %%xmm3, 48(%0)\n\t"
+        "add $64, %1\n\t"
+        "add $64, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(*dest), "+r"(*src), "+r"(blocks)
+        :
+        : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
 }
 
 void *memset(void *ptr, int value, size_t size)
 {
     uint8_t *p = (uint8_t *)ptr;
-    for (size_t i = 0; i < size; i++)
+    uint32_t pattern = (uint8_t)value * 0x01010101u;
+
+    // Align the destination so the bulk stores never split a line
+    size_t head = (-(uint32_t)p) & (cpu_sse2_enabled && size >= STRING_STREAM_MIN ? 15 : 3);
+    if (head > size)
+        head = size;
+    asm volatile("rep stosb" : "+D"(p), "+c"(head) : "a"(pattern) : "memory");
+    size -= (uint32_t)p - (uint32_t)ptr;
+
+    if (cpu_sse2_enabled && size >= STRING_STREAM_MIN)
     {
-        p[i] = (uint8_t)value;
+        p = stream_fill(p, pattern, size / 64);
+        size &= 63;
     }
+
+    size_t dwords = size / 4;
+    size_t tail = size & 3;
+    asm volatile("rep stosl\n\t"
+                 "mov %3, %%ecx\n\t"
+                 "rep stosb"
+                 : "+D"(p), "+c"(dwords)
+                 : "a"(pattern), "r"(tail)
+                 : "memory");
     return ptr;
 }
 
@@ -26,31 +139,317 @@ void *memcpy(void *dest, const void *src, size_t size)
 {
     uint8_t *d = (uint8_t *)dest;
     const uint8_t *s = (const uint8_t *)src;
-    for (size_t i = 0; i < size; i++)
+
+    // Align the destination: movntdq needs 16 bytes, rep movsd likes 4
+    size_t head = (-(uint32_t)d) & (cpu_sse2_enabled && size >= STRING_STREAM_MIN ? 15 : 3);
+    if (head > size)
+        head = size;
+    size -= head;
+    asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(head) : : "memory");
+
+    if (cpu_sse2_enabled && size >= STRING_STREAM_MIN)
     {
-        d[i] = s[i];
+        stream_copy(&d, &s, size / 64);
+        size &= 63;
     }
+
+    size_t dwords = size / 4;
+    size_t tail = size & 3;
+    asm volatile("rep movsl\n\t"
+                 "mov %3, %%ecx\n\t"
+                 "rep movsb"
+                 : "+D"(d), "+S"(s), "+c"(dwords)
+                 : "r"(tail)
+                 : "memory");
     return dest;
 }
 
-int strcmp(const char *str1, const char *str2)
+/**
+ * Copy between possibly overlapping buffers
+ */
+void *memmove(void *dest, const void *src, size_t size)
+{
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+
+    // A forward copy only reads bytes it has not yet overwritten unless the
+    // destination starts inside the source
+    if (d <= s || d >= s + size)
+        return memcpy(dest, src, size);
+
+    // Copy backwards from the end: odd bytes first, then whole dwords
+    size_t tail = size & 3;
+    size_t dwords = size / 4;
+    d += size - 1;
+    s += size - 1;
+    // Interrupt stubs clear the direction flag themselves (and IRET puts
+    // it back), so the copy can run with interrupts on
+    asm volatile("std\n\t"
+                 "rep movsb\n\t"
+                 "sub $3, %%esi\n\t"
+                 "sub $3, %%edi\n\t"
+                 "mov %3, %%ecx\n\t"
+                 "rep movsl\n\t"
+                 "cld"
+                 : "+D"(d), "+S"(s), "+c"(tail)
+                 : "r"(dwords)
+                 : "memory", "cc");
+    return dest;
+}
+
+int memcmp(const void *ptr1, const void *ptr2, size_t size)
 {
-    while (*str1 && (*str1 == *str2))
+    const uint8_t *p = (const uint8_t *)ptr1;
+    const uint8_t *q = (const uint8_t *)ptr2;
+
+    // Skip equal dwords, then find the first differing byte
+    while (size >= 4 && *(const string_word_t *)p == *(const string_word_t *)q)
     {
-        str1++;
-        str2++;
+        p += 4;
+        q += 4;
+        size -= 4;
     }
-    return *(unsigned char *)str1 - *(unsigned char *)str2;
+
+    while (size && *p == *q)
+    {
+        p++;
+        q++;
+        size--;
+    }
+
+    return size ? *p - *q : 0;
 }
 
-// Add a helper function for command parsing
-int strncmp(const char *str1, const char *str2, size_t n)
+/**
+ * Bitmask of the zero bytes in the aligned 16-byte block at `block`
+ */
+__attribute__((target("sse2"))) static inline uint32_t sse2_zero_mask(const char *block)
 {
-    while (n > 0 && *str1 && (*str1 == *str2))
+    uint32_t mask;
+    asm volatile("pxor %%xmm0, %%xmm0\n\t"
+                 "pcmpeqb (%1), %%xmm0\n\t"
+                 "pmovmskb %%xmm0, %0"
+                 : "=r"(mask)
+                 : "r"(block)
+                 : "xmm0", "memory");
+    return mask;
+}
+
+__attribute__((target("sse2"))) static size_t strlen_sse2(const char *str)
+{
+    const char *block = (const char *)((uint32_t)str & ~15u);
+
+    // Bytes of the first block before the string are shifted out
+    uint32_t mask = sse2_zero_mask(block) >> ((uint32_t)str & 15);
+    if (mask)
+        return __builtin_ctz(mask);
+
+    for (;;)
     {
-        str1++;
-        str2++;
+        block += 16;
+        mask = sse2_zero_mask(block);
+        if (mask)
+            return (size_t)(block - str) + __builtin_ctz(mask);
+    }
+}
+
+/**
+ * Look for the terminator a dword at a time, giving up once at least
+ * `limit` bytes are known to be non-zero. Returns true with the length in
+ * *length when found; otherwise *length is where the scan stopped.
+ */
+static bool strlen_swar(const char *str, size_t limit, size_t *length)
+{
+    const char *p = str;
+
+    while ((uint32_t)p & 3)
+    {
+        if (!*p)
+        {
+            *length = (size_t)(p - str);
+            return true;
+        }
+        p++;
+    }
+
+    while ((size_t)(p - str) < limit)
+    {
+        uint32_t flags = word_has_zero(*(const string_word_t *)p);
+        if (flags)
+        {
+            *length = (size_t)(p - str) + word_first_flag(flags);
+            return true;
+        }
+        p += 4;
+    }
+
+    *length = (size_t)(p - str);
+    return false;
+}
+
+size_t strlen(const char *str)
+{
+    size_t length;
+    if (strlen_swar(str, STRING_SSE2_MIN, &length))
+        return length;
+
+    // A long string: finish it 16 bytes at a time if SSE2 is free to use
+    if (string_sse2_usable())
+        return length + strlen_sse2(str + length);
+
+    size_t rest;
+    strlen_swar(str + length, (size_t)-1, &rest);
+    return length + rest;
+}
+
+/**
+ * Compare the 16 bytes at `p` (aligned) and `q`: returns a mask of the
+ * bytes that differ or end the string at `p`
+ */
+__attribute__((target("sse2"))) static inline uint32_t sse2_stop_mask(const char *p, const char *q)
+{
+    uint32_t mask;
+    asm volatile("movdqa (%1), %%xmm0\n\t"
+                 "movdqu (%2), %%xmm1\n\t"
+                 "pxor %%xmm2, %%xmm2\n\t"
+                 "pcmpeqb %%xmm0, %%xmm2\n\t" // Terminators in p
+                 "pcmpeqb %%xmm0, %%xmm1\n\t" // Equal bytes
+                 "pandn %%xmm1, %%xmm2\n\t"   // Equal and not a terminator
+                 "pmovmskb %%xmm2, %0"
+                 : "=r"(mask)
+                 : "r"(p), "r"(q)
+                 : "xmm0", "xmm1", "xmm2", "memory");
+    return ~mask & 0xFFFF;
+}
+
+/**
+ * Compare at most `n` bytes of two strings (n = (size_t)-1: unbounded).
+ * Whole blocks (dwords, and 16 bytes past STRING_SSE2_MIN) are compared
+ * while they are equal and hold no terminator; the final partial block is
+ * finished a byte at a time.
+ */
+static int string_compare_n(const char *str1, const char *str2, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)str1;
+    const unsigned char *q = (const unsigned char *)str2;
+    const unsigned char *sse2_from = string_sse2_usable() ? p + STRING_SSE2_MIN : NULL;
+
+    while (n)
+    {
+        if (sse2_from && p >= sse2_from && n >= 16 && !((uint32_t)p & 15) && string_read_safe(q, 16))
+        {
+            if (sse2_stop_mask((const char *)p, (const char *)q))
+                break;
+            p += 16;
+            q += 16;
+            n -= 16;
+        }
+        else if (n >= 4 && !((uint32_t)p & 3) && string_read_safe(q, 4))
+        {
+            uint32_t a = *(const string_word_t *)p;
+            if (a != *(const string_word_t *)q || word_has_zero(a))
+                break;
+            p += 4;
+            q += 4;
+            n -= 4;
+        }
+        else
+        {
+            if (*p != *q || !*p)
+                return *p - *q;
+            p++;
+            q++;
+            n--;
+        }
+    }
+
+    // The difference or terminator lies in the next block
+    while (n && *p && *p == *q)
+    {
+        p++;
+        q++;
         n--;
     }
-    return (n == 0) ? 0 : (*(unsigned char *)str1 - *(unsigned char *)str2);
+    return n ? *p - *q : 0;
+}
+
+int strcmp(const char *str1, const char *str2)
+{
+    return string_compare_n(str1, str2, (size_t)-1);
+}
+
+int strncmp(const char *str1, const char *str2, size_t n)
+{
+    return string_compare_n(str1, str2, n);
+}
+
+/**
+ * Find the first `value` byte in `size` bytes at `ptr`
+ */
+void *memchr(const void *ptr, int value, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)ptr;
+    unsigned char c = (unsigned char)value;
+    uint32_t pattern = c * STRING_ONES;
+
+    while (size && ((uint32_t)p & 3))
+    {
+        if (*p == c)
+            return (void *)p;
+        p++;
+        size--;
+    }
+
+    while (size >= 4)
+    {
+        uint32_t flags = word_has_zero(*(const string_word_t *)p ^ pattern);
+        if (flags)
+            return (void *)(p + word_first_flag(flags));
+        p += 4;
+        size -= 4;
+    }
+
+    while (size)
+    {
+        if (*p == c)
+            return (void *)p;
+        p++;
+        size--;
+    }
+    return NULL;
+}
+
+/**
+ * Find the first `value` character in a string (the terminator counts)
+ */
+char *strchr(const char *str, int value)
+{
+    const unsigned char *p = (const unsigned char *)str;
+    unsigned char c = (unsigned char)value;
+    uint32_t pattern = c * STRING_ONES;
+
+    while ((uint32_t)p & 3)
+    {
+        if (*p == c)
+            return (char *)p;
+        if (!*p)
+            return NULL;
+        p++;
+    }
+
+    for (;;)
+    {
+        uint32_t word = *(const string_word_t *)p;
+        uint32_t match = word_has_zero(word ^ pattern);
+        uint32_t end = word_has_zero(word);
+
+        if (match || end)
+        {
+            // Whichever comes first; a match on the terminator itself wins
+            if (match && (!end || __builtin_ctz(match) <= __builtin_ctz(end)))
+                return (char *)(p + word_first_flag(match));
+            return NULL;
+        }
+        p += 4;
+    }
 }
@@ -0,0 +1,261 @@
+/* Host Tests for kernel/mem/memory.c
+ *
+ * Builds the kernel heap into an i386 Linux program on top of a fake
+ * physical allocator that hands out pieces of one big mapping, then:
+ *
+ * - carves free holes 8 and 16 bytes bigger than each small size class
+ *   needs, so the class takes them whole, and checks that freeing such an
+ *   oversized block files it back under its own class;
+ * - frees and reuses blocks on both sides of every class boundary;
+ * - fuzzes random kmalloc()/kfree() sequences, checking that live blocks
+ *   never overlap and keep their contents, and that the statistics add up.
+ */
+
+#include "host.h"
+#include "../kernel/mem/pmm.h"
+
+#define HEAP_ARENA_SIZE 0x800000 // Fake physical memory
+#define FUZZ_ROUNDS 200000
+#define FUZZ_SLOTS 512
+#define FUZZ_MAX_SIZE 2048
+
+// ---------------------------------------------------------------------
+// Fake physical allocator: in-place claims grow up from the bottom of
+// the arena, page blocks come down from the top
+
+static uint32_t arena_base;
+static uint32_t arena_claimed;
+static uint32_t arena_limit;
+
+uint32_t pmm_metadata_end(void)
+{
+    return arena_claimed;
+}
+
+bool pmm_claim_range(uint32_t start, uint32_t end)
+{
+    if (start != arena_claimed || end > arena_limit)
+        return false;
+    arena_claimed = end;
+    return true;
+}
+
+uint32_t pmm_alloc_pages(uint32_t order)
+{
+    uint32_t size = (uint32_t)PAGE_SIZE << order;
+    if (arena_limit - arena_claimed < size)
+        return 0;
+    arena_limit -= size;
+    return arena_limit;
+}
+
+void vga_print(const char *str)
+{
+    put_str(str);
+}
+
+/**
+ * Start over with an empty heap on the whole arena
+ */
+static void heap_reset(void)
+{
+    arena_claimed = arena_base;
+    arena_limit = arena_base + HEAP_ARENA_SIZE;
+    memory_init();
+}
+
+// ---------------------------------------------------------------------
+// Checks
+
+static uint32_t failures = 0;
+
+static void fail(const char *what, uint32_t size)
+{
+    if (failures++ < 20)
+    {
+        put_str("FAIL ");
+        put_str(what);
+        put_str(" size ");
+        put_dec(size, 0);
+        put_str("\n");
+    }
+}
+
+/**
+ * Leave a free block of exactly `hole` bytes between two used blocks and
+ * return where its payload starts
+ */
+static uint8_t *carve_hole(uint32_t hole, void **guards)
+{
+    void *block = kmalloc(1024);
+    guards[0] = kmalloc(300); // Keeps the hole from merging forward
+    kfree(block);
+    guards[1] = kmalloc(1024 - hole); // Splits the freed block, leaving the hole
+    return (uint8_t *)block + 1032 - hole;
+}
+
+/**
+ * A small block taken whole from a hole `extra` bytes bigger than its
+ * class needs must go back to that class when freed - not to the next
+ * one up, whose requests it is too small for, and not past the last one
+ */
+static void oversized_blocks(uint32_t extra)
+{
+    for (uint32_t size = 16; size <= 256; size *= 2)
+    {
+        heap_reset(); // Empty class lists, and nothing but the hole fits
+        void *guards[2];
+        uint8_t *hole = carve_hole(size + 8 + extra, guards);
+
+        void *ptr = kmalloc(size);
+        if (ptr != hole)
+        {
+            fail("hole not taken", size);
+            continue;
+        }
+
+        kfree(ptr);
+        if (size < 256)
+        {
+            void *bigger = kmalloc(size * 2);
+            if (bigger == hole)
+                fail("oversized block filed under the next class", size);
+            kfree(bigger);
+        }
+        if (kmalloc(size) != hole)
+            fail("oversized block not reused by its class", size);
+    }
+}
+
+/**
+ * Free and reallocate sizes on both sides of each class boundary, filling
+ * every block completely so an undersized one overwrites its neighbour
+ */
+static void class_boundaries(void)
+{
+    static const uint32_t sizes[] = {0, 1, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+                                     127, 128, 129, 255, 256, 257, 264, 272};
+    static const uint32_t strides[] = {1, 3, 7, 9}; // Coprime to the count
+    const uint32_t count = sizeof(sizes) / sizeof(sizes[0]);
+    uint8_t *blocks[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (uint32_t round = 0; round < sizeof(strides) / sizeof(strides[0]); round++)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            blocks[i] = kmalloc(sizes[i]);
+            memset(blocks[i], (int)i + 1, sizes[i]);
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            for (uint32_t j = 0; j < sizes[i]; j++)
+            {
+                if (blocks[i][j] != (uint8_t)(i + 1))
+                {
+                    fail("class boundary block overwritten", sizes[i]);
+                    break;
+                }
+            }
+        }
+
+        // Free in a different order each round so the lists get mixed
+        for (uint32_t i = 0; i < count; i++)
+            kfree(blocks[(i * strides[round]) % count]);
+    }
+}
+
+static struct
+{
+    uint8_t *ptr;
+    uint32_t size;
+    uint8_t fill;
+} slots[FUZZ_SLOTS];
+
+static void check_slot(uint32_t i)
+{
+    for (uint32_t j = 0; j < slots[i].size; j++)
+    {
+        if (slots[i].ptr[j] != slots[i].fill)
+        {
+            fail("live block overwritten", slots[i].size);
+            return;
+        }
+    }
+}
+
+/**
+ * Mostly small random allocations and frees; every new block is checked
+ * against all live ones for overlap, and every freed block for its fill
+ */
+static void fuzz(void)
+{
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        uint32_t i = rng() % FUZZ_SLOTS;
+
+        if (slots[i].ptr)
+        {
+            check_slot(i);
+            kfree(slots[i].ptr);
+            slots[i].ptr = NULL;
+            continue;
+        }
+
+        uint32_t size = (rng() & 3) ? rng() % 300 : rng() % FUZZ_MAX_SIZE;
+        uint8_t *ptr = (rng() & 1) ? kmalloc(size) : kmalloc_nozero(size);
+        if (!ptr)
+        {
+            fail("out of memory", size);
+            return;
+        }
+        if ((uint32_t)ptr & 7)
+            fail("misaligned block", size);
+
+        for (uint32_t j = 0; j < FUZZ_SLOTS; j++)
+        {
+            if (slots[j].ptr && ptr < slots[j].ptr + slots[j].size && slots[j].ptr < ptr + size)
+            {
+                fail("overlapping blocks", size);
+                break;
+            }
+        }
+
+        slots[i].ptr = ptr;
+        slots[i].size = size;
+        slots[i].fill = (uint8_t)rng();
+        memset(ptr, slots[i].fill, size);
+    }
+
+    for (uint32_t i = 0; i < FUZZ_SLOTS; i++)
+    {
+        if (slots[i].ptr)
+        {
+            check_slot(i);
+            kfree(slots[i].ptr);
+            slots[i].ptr = NULL;
+        }
+    }
+}
+
+int test_main(void)
+{
+    arena_base = (uint32_t)host_map(HEAP_ARENA_SIZE);
+
+    oversized_blocks(8);
+    oversized_blocks(16);
+
+    heap_reset();
+    class_boundaries();
+    fuzz();
+
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+    if (stats.live_bytes || stats.live_allocations)
+        fail("live totals after freeing everything", stats.live_bytes);
+    if (stats.free_bytes + stats.segments * 8 != stats.heap_size)
+        fail("free bytes after freeing everything", stats.free_bytes);
+
+    put_str(failures ? "heap tests FAILED\n" : "heap tests passed\n");
+    return failures ? 1 : 0;
+}
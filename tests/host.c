@@ -0,0 +1,107 @@
+/* Minimal i386 Linux runtime for the host tests (see host.h) */
+
+#include "host.h"
+#include "../kernel/arch/cpu.h"
+#include "../kernel/arch/fpu.h"
+
+// Configuration the string routines read (arch/cpu.c and arch/fpu.c in the kernel)
+bool cpu_sse2_enabled = false;
+bool fpu_trap_armed = false;
+
+#define SYS_EXIT 1
+#define SYS_WRITE 4
+#define SYS_MMAP 90
+#define SYS_MPROTECT 125
+
+#define PROT_NONE 0
+#define PROT_RW 3
+#define MAP_PRIVATE_ANONYMOUS 0x22
+
+static int32_t host_syscall(uint32_t number, uint32_t a, uint32_t b, uint32_t c)
+{
+    int32_t result;
+    asm volatile("int $0x80" : "=a"(result) : "a"(number), "b"(a), "c"(b), "d"(c) : "memory");
+    return result;
+}
+
+void host_exit(int code)
+{
+    host_syscall(SYS_EXIT, (uint32_t)code, 0, 0);
+    for (;;)
+        ;
+}
+
+void put_str(const char *str)
+{
+    uint32_t length = 0;
+    while (str[length])
+        length++;
+    host_syscall(SYS_WRITE, 1, (uint32_t)str, length);
+}
+
+void put_dec(uint32_t value, uint32_t width)
+{
+    char digits[12];
+    uint32_t count = 0;
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    char line[24];
+    uint32_t length = 0;
+    while (count + length < width && length < 12)
+        line[length++] = ' ';
+    while (count)
+        line[length++] = digits[--count];
+    line[length] = '\0';
+    put_str(line);
+}
+
+/**
+ * `size` bytes of zeroed, page-aligned read-write memory
+ */
+uint8_t *host_map(uint32_t size)
+{
+    uint32_t args[6] = {0, size, PROT_RW, MAP_PRIVATE_ANONYMOUS, (uint32_t)-1, 0};
+    int32_t mapping = host_syscall(SYS_MMAP, (uint32_t)args, 0, 0);
+    if (mapping < 0 && mapping > -4096)
+    {
+        put_str("mmap failed\n");
+        host_exit(2);
+    }
+    return (uint8_t *)mapping;
+}
+
+/**
+ * Two pages: the first read-write, the second inaccessible
+ */
+uint8_t *map_guarded_page(void)
+{
+    uint8_t *page = host_map(2 * HOST_PAGE_SIZE);
+    host_syscall(SYS_MPROTECT, (uint32_t)page + HOST_PAGE_SIZE, HOST_PAGE_SIZE, PROT_NONE);
+    return page;
+}
+
+bool host_has_sse2(void)
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return edx & (1u << 26);
+}
+
+static uint32_t rng_state = 0x12345678;
+
+uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+__attribute__((force_align_arg_pointer)) void _start(void)
+{
+    host_exit(test_main());
+}
@@ -0,0 +1,32 @@
+#ifndef TESTS_HOST_H
+#define TESTS_HOST_H
+
+/* Minimal i386 Linux runtime for the host tests
+ *
+ * There is no C library for i386 on most hosts, so the tests bring the
+ * few system calls they need and run from their own _start, which calls
+ * test_main() and exits with its result.
+ */
+
+#include "../kernel/kernel.h"
+
+#define HOST_PAGE_SIZE 4096
+
+int test_main(void);
+
+void host_exit(int code);
+void put_str(const char *str);
+void put_dec(uint32_t value, uint32_t width);
+uint8_t *host_map(uint32_t size);
+uint8_t *map_guarded_page(void);
+bool host_has_sse2(void);
+uint32_t rng(void);
+
+static inline uint32_t read_tsc(void)
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
+#endif
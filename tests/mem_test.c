@@ -0,0 +1,341 @@
+/* Host Tests for the memory routines in libc/string.c
+ *
+ * Fuzzes memcpy, memset, memcmp and memmove against plain byte loops at
+ * every alignment and at sizes on both sides of the streaming threshold,
+ * with memmove overlapping in both directions, then times each routine
+ * from 8 bytes to 1MB. Runs without SSE2 and, when the host has it, with
+ * SSE2 (which the large copies and fills stream through).
+ *
+ * Buffers that end at a page followed by an inaccessible one catch any
+ * read or write past the end.
+ */
+
+#include "host.h"
+#include "../kernel/arch/cpu.h"
+
+#define FUZZ_ROUNDS 20000
+#define FUZZ_MAX_SIZE 300
+#define LARGE_SIZE 0x48000 // Past the 256KB streaming threshold, not block-sized
+#define ARENA_SIZE 0x300000
+#define BENCH_BYTES 0x400000 // Processed per measurement
+
+static const uint32_t bench_sizes[] = {8, 64, 512, 4096, 32768, 262144, 1048576};
+
+// ---------------------------------------------------------------------
+// Byte-loop references
+
+static void ref_memcpy(uint8_t *dest, const uint8_t *src, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+        dest[i] = src[i];
+}
+
+static void ref_memset(uint8_t *ptr, uint8_t value, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+        ptr[i] = value;
+}
+
+static void ref_memmove(uint8_t *dest, const uint8_t *src, uint32_t size)
+{
+    if (dest < src)
+    {
+        for (uint32_t i = 0; i < size; i++)
+            dest[i] = src[i];
+    }
+    else
+    {
+        for (uint32_t i = size; i; i--)
+            dest[i - 1] = src[i - 1];
+    }
+}
+
+static int ref_memcmp(const uint8_t *p, const uint8_t *q, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (p[i] != q[i])
+            return p[i] - q[i];
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Checks
+
+static uint32_t failures = 0;
+static const char *mode_name = "";
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+static void fail(const char *what, uint32_t size, uint32_t offset)
+{
+    if (failures++ < 20)
+    {
+        put_str("FAIL ");
+        put_str(what);
+        put_str(" [");
+        put_str(mode_name);
+        put_str("] size ");
+        put_dec(size, 0);
+        put_str(" offset ");
+        put_dec(offset, 0);
+        put_str("\n");
+    }
+}
+
+static void random_fill(uint8_t *ptr, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+        ptr[i] = (uint8_t)rng();
+}
+
+/**
+ * Run one routine on `actual` and its reference on `expected` (same
+ * contents, `window` bytes each) and compare the whole windows, so a
+ * stray write before or after the target shows up too
+ */
+static void compare_windows(const char *what, const uint8_t *actual, const uint8_t *expected, uint32_t window,
+                            uint32_t size, uint32_t offset)
+{
+    if (ref_memcmp(actual, expected, window) != 0)
+        fail(what, size, offset);
+}
+
+/**
+ * One copy, fill, compare and two overlapping moves of `size` bytes with
+ * the destination `dest_offset` and the source `src_offset` into their
+ * buffers
+ */
+static void check_size(uint8_t *a, uint8_t *b, uint8_t *c, uint32_t size, uint32_t dest_offset, uint32_t src_offset)
+{
+    uint32_t window = size + 64;
+
+    // memcpy between separate buffers
+    random_fill(a, window);
+    random_fill(b, window);
+    ref_memcpy(c, a, window);
+    if (memcpy(a + dest_offset, b + src_offset, size) != a + dest_offset)
+        fail("memcpy return value", size, dest_offset);
+    ref_memcpy(c + dest_offset, b + src_offset, size);
+    compare_windows("memcpy", a, c, window, size, dest_offset);
+
+    // memset
+    uint8_t value = (uint8_t)rng();
+    ref_memcpy(c, a, window);
+    if (memset(a + dest_offset, value, size) != a + dest_offset)
+        fail("memset return value", size, dest_offset);
+    ref_memset(c + dest_offset, value, size);
+    compare_windows("memset", a, c, window, size, dest_offset);
+
+    // memcmp: equal, then one byte changed (high bit too, for signedness)
+    random_fill(a, window);
+    ref_memcpy(b, a, window);
+    if (memcmp(a + dest_offset, b + dest_offset, size) != 0)
+        fail("memcmp equal", size, dest_offset);
+    if (size)
+    {
+        uint32_t at = dest_offset + rng() % size;
+        b[at] ^= (uint8_t)(rng() | 1);
+        if (sign(memcmp(a + dest_offset, b + dest_offset, size)) != sign(ref_memcmp(a + dest_offset, b + dest_offset, size)))
+            fail("memcmp", size, dest_offset);
+        if (sign(memcmp(b + dest_offset, a + dest_offset, size)) != sign(ref_memcmp(b + dest_offset, a + dest_offset, size)))
+            fail("memcmp reversed", size, dest_offset);
+    }
+
+    // memmove within one buffer, the destination above and then below the
+    // source by at most the size (so they overlap unless the gap is 0)
+    uint32_t gap = size ? 1 + rng() % size : 0;
+    if (gap > 32 && (rng() & 1))
+        gap = 1 + (rng() & 31); // Small gaps are the hard case
+    random_fill(a, window + gap);
+    ref_memcpy(c, a, window + gap);
+    if (memmove(a + src_offset + gap, a + src_offset, size) != a + src_offset + gap)
+        fail("memmove return value", size, gap);
+    ref_memmove(c + src_offset + gap, c + src_offset, size);
+    compare_windows("memmove up", a, c, window + gap, size, gap);
+
+    random_fill(a, window + gap);
+    ref_memcpy(c, a, window + gap);
+    memmove(a + src_offset, a + src_offset + gap, size);
+    ref_memmove(c + src_offset, c + src_offset + gap, size);
+    compare_windows("memmove down", a, c, window + gap, size, gap);
+}
+
+/**
+ * Random sizes at every pair of alignments within a 16-byte block
+ */
+static void fuzz(uint8_t *arena)
+{
+    uint8_t *a = arena;
+    uint8_t *b = arena + FUZZ_MAX_SIZE * 4;
+    uint8_t *c = arena + FUZZ_MAX_SIZE * 8;
+
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        uint32_t size = rng() % FUZZ_MAX_SIZE;
+        check_size(a, b, c, size, round & 15, (round >> 4) & 15);
+    }
+}
+
+/**
+ * Sizes around the streaming threshold, where the SSE2 paths take over
+ */
+static void large(uint8_t *arena)
+{
+    uint8_t *a = arena;
+    uint8_t *b = arena + ARENA_SIZE / 3;
+    uint8_t *c = arena + 2 * ARENA_SIZE / 3;
+
+    for (uint32_t round = 0; round < 8; round++)
+    {
+        uint32_t size = LARGE_SIZE - 0x10000 + rng() % 0x20000;
+        check_size(a, b, c, size, rng() & 15, rng() & 15);
+    }
+}
+
+/**
+ * Buffers whose last byte is the last byte before an inaccessible page:
+ * a read or write past the end kills the test with SIGSEGV
+ */
+static void page_boundary(uint8_t *page1, uint8_t *page2)
+{
+    for (uint32_t size = 0; size < 160; size++)
+    {
+        uint8_t *a = page1 + HOST_PAGE_SIZE - size;
+        uint8_t *b = page2 + HOST_PAGE_SIZE - size;
+
+        random_fill(b, size);
+        memcpy(a, b, size);
+        if (memcmp(a, b, size) != 0 || ref_memcmp(a, b, size) != 0)
+            fail("memcpy at page end", size, (uint32_t)a & 15);
+
+        memset(a, 0x5A, size);
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if (a[i] != 0x5A)
+            {
+                fail("memset at page end", size, (uint32_t)a & 15);
+                break;
+            }
+        }
+
+        // Shift the buffer up to the page end and back down again
+        if (size > 4)
+        {
+            ref_memcpy(a, b, size);
+            memmove(a + 3, a, size - 3);
+            memmove(a, a + 3, size - 3);
+            if (ref_memcmp(a, b, size - 3) != 0)
+                fail("memmove at page end", size, (uint32_t)a & 15);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// Benchmark
+
+static volatile uint32_t bench_sink;
+
+enum
+{
+    BENCH_MEMCPY,
+    BENCH_MEMSET,
+    BENCH_MEMMOVE, // Overlapping, destination above the source (backwards)
+    BENCH_MEMCMP,  // Equal buffers, so every byte is compared
+};
+
+static uint32_t bench_one(uint32_t which, uint8_t *a, uint8_t *b, uint32_t size, bool reference)
+{
+    uint32_t calls = BENCH_BYTES / size;
+    uint32_t start = read_tsc();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        asm volatile("" : : "r"(a), "r"(b) : "memory"); // Keep the call in the loop
+        switch (which)
+        {
+        case BENCH_MEMCPY:
+            reference ? ref_memcpy(a, b, size) : (void)memcpy(a, b, size);
+            break;
+        case BENCH_MEMSET:
+            reference ? ref_memset(a, (uint8_t)i, size) : (void)memset(a, (int)i, size);
+            break;
+        case BENCH_MEMMOVE:
+            reference ? ref_memmove(a + 8, a, size) : (void)memmove(a + 8, a, size);
+            break;
+        case BENCH_MEMCMP:
+            bench_sink += reference ? ref_memcmp(a, b, size) : memcmp(a, b, size);
+            break;
+        }
+    }
+    return (read_tsc() - start) / (BENCH_BYTES / 1024);
+}
+
+/**
+ * Cycles per KB processed, byte loops against the library in the current
+ * configuration
+ */
+static void bench(uint8_t *arena)
+{
+    uint8_t *a = arena;
+    uint8_t *b = arena + ARENA_SIZE / 2;
+    random_fill(b, bench_sizes[sizeof(bench_sizes) / sizeof(bench_sizes[0]) - 1]);
+
+    put_str("     SIZE memcpy: BYTE   LIB memset: BYTE   LIB memmove: BYTE   LIB memcmp: BYTE   LIB  (cycles/KB)\n");
+    for (uint32_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+    {
+        uint32_t size = bench_sizes[i];
+        put_dec(size, 9);
+        put_dec(bench_one(BENCH_MEMCPY, a, b, size, true), 14);
+        put_dec(bench_one(BENCH_MEMCPY, a, b, size, false), 6);
+        put_dec(bench_one(BENCH_MEMSET, a, b, size, true), 13);
+        put_dec(bench_one(BENCH_MEMSET, a, b, size, false), 6);
+        put_dec(bench_one(BENCH_MEMMOVE, a, b, size, true), 14);
+        put_dec(bench_one(BENCH_MEMMOVE, a, b, size, false), 6);
+        ref_memcpy(a, b, size); // Equal buffers for memcmp
+        put_dec(bench_one(BENCH_MEMCMP, a, b, size, true), 13);
+        put_dec(bench_one(BENCH_MEMCMP, a, b, size, false), 6);
+        put_str("\n");
+    }
+}
+
+int test_main(void)
+{
+    static const struct
+    {
+        const char *name;
+        bool sse2;
+    } modes[] = {
+        {"no sse2", false},
+        {"sse2", true},
+    };
+
+    bool sse2 = host_has_sse2();
+    uint8_t *arena = host_map(ARENA_SIZE);
+    uint8_t *page1 = map_guarded_page();
+    uint8_t *page2 = map_guarded_page();
+
+    for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        if (modes[i].sse2 && !sse2)
+            continue;
+
+        mode_name = modes[i].name;
+        cpu_sse2_enabled = modes[i].sse2;
+
+        uint32_t before = failures;
+        fuzz(arena);
+        large(arena);
+        page_boundary(page1, page2);
+
+        put_str(mode_name);
+        put_str(failures == before ? ": ok\n" : ": FAILED\n");
+        bench(arena);
+    }
+
+    put_str(failures ? "memory routine tests FAILED\n" : "memory routine tests passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+/* Host Tests for libc/string.c
+ *
+ * Builds the kernel's string routines into an i386 Linux program and
+ * fuzzes strlen, strcmp, strncmp, memchr and strchr against plain byte
+ * loops, then times both. Every routine runs in three configurations:
+ * no SSE2, SSE2 present but the lazy FPU trap armed (both must stay on
+ * the SWAR path), and SSE2 live.
+ *
+ * The string scans read whole dwords or 16-byte blocks past the
+ * terminator, so the page-boundary tests place strings and buffers so
+ * that they end exactly at a page followed by an inaccessible one: a read
+ * that crosses into it kills the test with SIGSEGV.
+ */
+
+#include "host.h"
+#include "../kernel/arch/cpu.h"
+#include "../kernel/arch/fpu.h"
+
+#define FUZZ_ROUNDS 20000
+#define FUZZ_MAX_LENGTH 300
+#define PAGE_SIZE HOST_PAGE_SIZE
+#define BENCH_BYTES 0x100000 // Scanned per measurement
+
+static const uint32_t bench_lengths[] = {8, 32, 128, 512, 2048};
+
+// ---------------------------------------------------------------------
+// Byte-loop references
+
+static size_t ref_strlen(const char *str)
+{
+    size_t length = 0;
+    while (str[length])
+        length++;
+    return length;
+}
+
+static int ref_strncmp(const char *str1, const char *str2, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)str1;
+    const unsigned char *q = (const unsigned char *)str2;
+    for (; n; n--, p++, q++)
+    {
+        if (*p != *q || !*p)
+            return *p - *q;
+    }
+    return 0;
+}
+
+static const void *ref_memchr(const void *ptr, int value, size_t size)
+{
+    const unsigned char *p = ptr;
+    for (; size; size--, p++)
+    {
+        if (*p == (unsigned char)value)
+            return p;
+    }
+    return NULL;
+}
+
+static const char *ref_strchr(const char *str, int value)
+{
+    for (;; str++)
+    {
+        if (*str == (char)value)
+            return str;
+        if (!*str)
+            return NULL;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Checks
+
+static uint32_t failures = 0;
+static const char *mode_name = "";
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+static void fail(const char *what, uint32_t length, uint32_t offset)
+{
+    if (failures++ < 20)
+    {
+        put_str("FAIL ");
+        put_str(what);
+        put_str(" [");
+        put_str(mode_name);
+        put_str("] length ");
+        put_dec(length, 0);
+        put_str(" offset ");
+        put_dec(offset, 0);
+        put_str("\n");
+    }
+}
+
+/**
+ * Fill `length` random non-zero bytes (high bytes included, to catch
+ * signed comparisons) and terminate
+ */
+static void random_string(char *str, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++)
+    {
+        str[i] = (char)(rng() % 255 + 1);
+    }
+    str[length] = '\0';
+}
+
+static void check_strings(const char *a, const char *b, uint32_t length, uint32_t offset)
+{
+    if (strlen(a) != ref_strlen(a))
+        fail("strlen", length, offset);
+    if (sign(strcmp(a, b)) != sign(ref_strncmp(a, b, (size_t)-1)))
+        fail("strcmp", length, offset);
+
+    size_t n = rng() % (length + 20);
+    if (sign(strncmp(a, b, n)) != sign(ref_strncmp(a, b, n)))
+        fail("strncmp", length, offset);
+
+    int value = (rng() & 7) ? (unsigned char)a[rng() % (length + 1)] : (int)(rng() & 0xFF);
+    if (strchr(a, value) != ref_strchr(a, value))
+        fail("strchr", length, offset);
+}
+
+/**
+ * Random strings at random alignments, compared against a copy with a
+ * random change: a different byte, an early end, or none
+ */
+static void fuzz(void)
+{
+    static char buffer1[FUZZ_MAX_LENGTH + 64] __attribute__((aligned(16)));
+    static char buffer2[FUZZ_MAX_LENGTH + 64] __attribute__((aligned(16)));
+
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        uint32_t length = rng() % FUZZ_MAX_LENGTH;
+        uint32_t offset1 = rng() & 31;
+        uint32_t offset2 = rng() & 31;
+        char *a = buffer1 + offset1;
+        char *b = buffer2 + offset2;
+
+        random_string(a, length);
+        for (uint32_t i = 0; i <= length; i++)
+            b[i] = a[i];
+
+        uint32_t change = rng() % 3;
+        if (change == 0 && length)
+            b[rng() % length] = (char)(rng() % 255 + 1);
+        else if (change == 1)
+            b[rng() % (length + 1)] = '\0';
+
+        check_strings(a, b, length, offset1);
+
+        int value = (int)(rng() & 0xFF);
+        size_t size = rng() % (length + 1);
+        if (memchr(a, value, size) != ref_memchr(a, value, size))
+            fail("memchr", size, offset1);
+    }
+}
+
+/**
+ * Strings, and memchr buffers, whose last byte is the last byte before
+ * an inaccessible page, at every offset within a 16-byte block
+ */
+static void page_boundary(uint8_t *page1, uint8_t *page2)
+{
+    for (uint32_t length = 0; length < 160; length++)
+    {
+        char *a = (char *)page1 + PAGE_SIZE - 1 - length;
+        char *b = (char *)page2 + PAGE_SIZE - 1 - length;
+        random_string(a, length);
+
+        // Equal, and differing in the last byte
+        for (uint32_t i = 0; i <= length; i++)
+            b[i] = a[i];
+        check_strings(a, b, length, (uint32_t)a & 15);
+        if (length)
+        {
+            b[length - 1] ^= 0x40;
+            check_strings(a, b, length, (uint32_t)a & 15);
+            check_strings(b, a, length, (uint32_t)b & 15);
+        }
+
+        // The other string ends early, well away from its page end
+        char *c = (char *)page2 + PAGE_SIZE / 2 + (length & 15);
+        for (uint32_t i = 0; i < length / 2; i++)
+            c[i] = a[i];
+        c[length / 2] = '\0';
+        check_strings(a, c, length, (uint32_t)a & 15);
+        check_strings(c, a, length / 2, (uint32_t)c & 15);
+
+        // Searches for a character that is rarely there run up to the page end
+        if (strchr(a, 0x100 - 1) != ref_strchr(a, 0x100 - 1))
+            fail("strchr at page end", length, (uint32_t)a & 15);
+        uint8_t *block = page1 + PAGE_SIZE - length;
+        if (memchr(block, 0, length) != ref_memchr(block, 0, length))
+            fail("memchr at page end", length, (uint32_t)block & 15);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Benchmark
+
+static volatile uint32_t bench_sink;
+
+static uint32_t bench_strlen(const char *str, uint32_t length, bool reference)
+{
+    uint32_t calls = BENCH_BYTES / (length + 1);
+    uint32_t start = read_tsc();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        asm volatile("" : : "r"(str) : "memory"); // Keep the call in the loop
+        bench_sink += reference ? ref_strlen(str) : strlen(str);
+    }
+    return (read_tsc() - start) / (BENCH_BYTES / 1024);
+}
+
+static uint32_t bench_strcmp(const char *str1, const char *str2, uint32_t length, bool reference)
+{
+    uint32_t calls = BENCH_BYTES / (length + 1);
+    uint32_t start = read_tsc();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        asm volatile("" : : "r"(str1), "r"(str2) : "memory");
+        bench_sink += reference ? ref_strncmp(str1, str2, (size_t)-1) : strcmp(str1, str2);
+    }
+    return (read_tsc() - start) / (BENCH_BYTES / 1024);
+}
+
+/**
+ * Cycles per KB scanned, byte loops against the library in the current
+ * configuration
+ */
+static void bench(void)
+{
+    static char str1[2048 + 16] __attribute__((aligned(16)));
+    static char str2[2048 + 16] __attribute__((aligned(16)));
+
+    put_str("  LENGTH  strlen: BYTE   LIB   strcmp: BYTE   LIB  (cycles/KB)\n");
+    for (uint32_t i = 0; i < sizeof(bench_lengths) / sizeof(bench_lengths[0]); i++)
+    {
+        uint32_t length = bench_lengths[i];
+        random_string(str1, length);
+        for (uint32_t j = 0; j <= length; j++)
+            str2[j + 1] = str1[j]; // Misaligned against str1
+
+        put_dec(length, 8);
+        put_dec(bench_strlen(str1, length, true), 14);
+        put_dec(bench_strlen(str1, length, false), 6);
+        put_dec(bench_strcmp(str1, str2 + 1, length, true), 15);
+        put_dec(bench_strcmp(str1, str2 + 1, length, false), 6);
+        put_str("\n");
+    }
+}
+
+int test_main(void)
+{
+    static const struct
+    {
+        const char *name;
+        bool sse2;
+        bool trap_armed;
+    } modes[] = {
+        {"swar", false, false},
+        {"sse2, fpu trap armed", true, true},
+        {"sse2", true, false},
+    };
+
+    bool sse2 = host_has_sse2();
+    uint8_t *page1 = map_guarded_page();
+    uint8_t *page2 = map_guarded_page();
+
+    for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        if (modes[i].sse2 && !sse2)
+            continue;
+
+        mode_name = modes[i].name;
+        cpu_sse2_enabled = modes[i].sse2;
+        fpu_trap_armed = modes[i].trap_armed;
+
+        uint32_t before = failures;
+        fuzz();
+        page_boundary(page1, page2);
+
+        put_str(mode_name);
+        put_str(failures == before ? ": ok\n" : ": FAILED\n");
+        bench();
+    }
+
+    put_str(failures ? "string tests FAILED\n" : "string tests passed\n");
+    return failures ? 1 : 0;
+}